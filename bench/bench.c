@@ -0,0 +1,164 @@
+/**
+ * bench.c
+ *
+ * This file contains the function definitions shared by the benchmarks.
+ *
+ * Each benchmark compares a path through the library with the one it replaced
+ * and prints one line per path, so runs can be compared by eye or with diff.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "bench.h"
+
+/**
+ * This is a duplicate of stdout while it is sent to /dev/null.
+ */
+static int saved_stdout = -1;
+
+/**
+ * This function returns the integer argument at index i of argv, or def if
+ * there are not that many arguments.
+ */
+uint64_t bench_arg(int argc, char* argv[], int i, uint64_t def)
+{
+    return (i < argc) ? strtoull(argv[i], NULL, 10) : def;
+}
+
+/**
+ * This function returns the resident set size of the program in kilobytes.
+ */
+uint64_t bench_rss_kb()
+{
+    FILE* fs;               /* The statm file. */
+    unsigned long size;     /* The size of the program in pages. */
+    unsigned long rss;      /* The resident pages. */
+
+    /* Reading the number of resident pages. */
+    if ((fs = fopen("/proc/self/statm", "r")) == NULL)
+        return 0;
+    if (fscanf(fs, "%lu %lu", &size, &rss) != 2)
+        rss = 0;
+    fclose(fs);
+
+    return (uint64_t) rss * (uint64_t) sysconf(_SC_PAGESIZE) / 1024;
+}
+
+/**
+ * This function returns the CPU time the program has used in nanoseconds.
+ */
+uint64_t bench_cpu_ns()
+{
+    struct rusage ru;   /* The resources used by the program. */
+
+    /* Adding up the user and kernel time. */
+    getrusage(RUSAGE_SELF, &ru);
+
+    return ((uint64_t) ru.ru_utime.tv_sec + (uint64_t) ru.ru_stime.tv_sec)
+           * NANOS_PER_SEC
+           + ((uint64_t) ru.ru_utime.tv_usec + (uint64_t) ru.ru_stime.tv_usec)
+           * 1000;
+}
+
+/**
+ * This function prints the result of one path of a benchmark.
+ */
+void bench_report(char* name, uint64_t ns, uint64_t ops, uint64_t bytes)
+{
+    double secs = (double) ns / NANOS_PER_SEC;  /* How long it took. */
+
+    fprintf(stdout, "%-32s %10.3f ms", name, secs * 1000);
+    if (ops > 0)
+        fprintf(stdout, "  %12.0f ops/s  %9.1f ns/op",
+                ops / secs, (double) ns / ops);
+    if (bytes > 0)
+        fprintf(stdout, "  %9.3f GB/s", bytes / secs / 1e9);
+    fprintf(stdout, "\n");
+    fflush(stdout);
+}
+
+/**
+ * This function creates a directory under /tmp for the output of the
+ * benchmark named by name, and returns its path followed by a slash.
+ */
+char* bench_mkdir(char* name)
+{
+    char* tmpl;     /* The template of the path. */
+    char* dir;      /* The path of the directory. */
+
+    /* Making a directory of our own. */
+    strfmt(&tmpl, "/tmp/%s_XXXXXX", name);
+    if (mkdtemp(tmpl) == NULL)
+    {
+        fprintf(stderr, "[ %s ] ERROR: In bench_mkdir(): mkdtemp() - %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* The library expects the directory to end with a slash. */
+    strfmt(&dir, "%s/", tmpl);
+    free(tmpl);
+
+    return dir;
+}
+
+/**
+ * This function removes the directory created by bench_mkdir() along with the
+ * files in it, and frees its path.
+ */
+void bench_rmdir(char* dir)
+{
+    DIR* d;                 /* The directory. */
+    struct dirent* ent;     /* The current entry of the directory. */
+
+    /* Removing the files, then the directory. */
+    if ((d = opendir(dir)) != NULL)
+    {
+        while ((ent = readdir(d)) != NULL)
+            if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0)
+                unlinkat(dirfd(d), ent->d_name, 0);
+        closedir(d);
+    }
+    rmdir(dir);
+    free(dir);
+}
+
+/**
+ * This function watches the sub-process provided to it with the evloop
+ * provided until it has been reaped.
+ */
+void bench_reap(subproc* sp, evloop* ev)
+{
+    /* Running the evloop until the sub-process is reaped. */
+    subproc_watch(sp, ev, NULL, NULL);
+    while (subproc_running(sp))
+        evloop_run(ev, -1);
+}
+
+/**
+ * This function sends stdout to /dev/null until bench_loud() is called.
+ */
+void bench_quiet()
+{
+    int fd;     /* /dev/null. */
+
+    /* Keeping stdout so it can be put back. */
+    fflush(stdout);
+    saved_stdout = dup(STDOUT_FILENO);
+    fd = openfd("/dev/null", O_WRONLY | O_CLOEXEC, 0);
+    dup2(fd, STDOUT_FILENO);
+    closefd(fd);
+}
+
+/**
+ * This function sends stdout back to where it went before bench_quiet().
+ */
+void bench_loud()
+{
+    /* Putting stdout back. */
+    fflush(stdout);
+    dup2(saved_stdout, STDOUT_FILENO);
+    closefd(saved_stdout);
+    saved_stdout = -1;
+}
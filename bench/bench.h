@@ -0,0 +1,81 @@
+/**
+ * bench.h
+ *
+ * This file contains the function prototype declarations shared by the
+ * benchmarks.
+ *
+ * Each benchmark compares a path through the library with the one it replaced
+ * and prints one line per path, so runs can be compared by eye or with diff.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/resource.h>
+
+#include "mycutils.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This function returns the integer argument at index i of argv, or def if
+ * there are not that many arguments.
+ */
+uint64_t bench_arg(int argc, char* argv[], int i, uint64_t def);
+
+/**
+ * This function returns the resident set size of the program in kilobytes.
+ */
+uint64_t bench_rss_kb();
+
+/**
+ * This function returns the CPU time the program has used, in user and kernel
+ * mode together, in nanoseconds. Children are not included.
+ */
+uint64_t bench_cpu_ns();
+
+/**
+ * This function prints the result of one path of a benchmark: how long ops
+ * operations that moved bytes bytes took, and the rates they come to. Either
+ * count may be 0 if it does not apply.
+ */
+void bench_report(char* name, uint64_t ns, uint64_t ops, uint64_t bytes);
+
+/**
+ * This function creates a directory under /tmp for the output of the
+ * benchmark named by name, and returns its path followed by a slash.
+ */
+char* bench_mkdir(char* name);
+
+/**
+ * This function removes the directory created by bench_mkdir() along with the
+ * files in it, and frees its path.
+ */
+void bench_rmdir(char* dir);
+
+/**
+ * This function watches the sub-process provided to it with the evloop
+ * provided until it has been reaped.
+ */
+void bench_reap(subproc* sp, evloop* ev);
+
+/**
+ * This function sends stdout to /dev/null, so the status messages printed by
+ * the library do not swamp the results, until bench_loud() is called.
+ */
+void bench_quiet();
+
+/**
+ * This function sends stdout back to where it went before bench_quiet().
+ */
+void bench_loud();
+
+#endif // BENCH_H
@@ -0,0 +1,150 @@
+/**
+ * bench_fmt.c
+ *
+ * This file benchmarks formatting the strings that subproc.c and main.c
+ * format with strfmt(), astrfmt() and strbuf_fmt() against the strfmt() that
+ * formatted everything twice and always allocated.
+ *
+ * Usage: bench_fmt [millions]
+ * Each format is formatted 2 million times per path by default.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "bench.h"
+
+/**
+ * This formats the arguments that follow fmt n times with each path, and
+ * prints the result of each as name followed by the path.
+ */
+#define BENCH_FMT(name, n, fmt, ...)                                        \
+    do                                                                      \
+    {                                                                       \
+        for (t = mono_now(), i = 0; i < (n); i++)                           \
+        {                                                                   \
+            ref_strfmt(&str, fmt, __VA_ARGS__);                             \
+            bytes += strlen(str);                                           \
+            free(str);                                                      \
+        }                                                                   \
+        report(name, "ref_strfmt", mono_now() - t, n);                      \
+        for (t = mono_now(), i = 0; i < (n); i++)                           \
+        {                                                                   \
+            strfmt(&str, fmt, __VA_ARGS__);                                 \
+            bytes += strlen(str);                                           \
+            free(str);                                                      \
+        }                                                                   \
+        report(name, "strfmt", mono_now() - t, n);                          \
+        for (t = mono_now(), i = 0; i < (n); i++)                           \
+        {                                                                   \
+            if (i % 1024 == 0)                                              \
+                arena_reset(&a);                                            \
+            bytes += strlen(astrfmt(&a, fmt, __VA_ARGS__));                 \
+        }                                                                   \
+        report(name, "astrfmt", mono_now() - t, n);                         \
+        for (t = mono_now(), i = 0; i < (n); i++)                           \
+        {                                                                   \
+            strbuf_reset(&sb);                                              \
+            strbuf_fmt(&sb, fmt, __VA_ARGS__);                              \
+            bytes += sb.len;                                                \
+        }                                                                   \
+        report(name, "strbuf_fmt", mono_now() - t, n);                      \
+    } while (0)
+
+/**
+ * This function returns the number of bytes a string formatted from the
+ * argument list needs, as vbytesfmt() did before strfmt() was replaced.
+ */
+size_t ref_vbytesfmt(va_list lp, char* fmt)
+{
+    va_list lp_cpy; /* A Copy of the list of arguments. */
+    size_t bytes;   /* The number of bytes the string needs. */
+
+    /* Getting the number of bytes the string will need, plus the null
+     * character. */
+    va_copy(lp_cpy, lp);
+    bytes = vsnprintf(NULL, 0, fmt, lp_cpy) + sizeof(char);
+    va_end(lp_cpy);
+
+    return bytes;
+}
+
+/**
+ * This function formats a string, as strfmt() did before it was replaced:
+ * once to measure it, then again into memory allocated for it.
+ */
+void ref_strfmt(char** sp, char* fmt, ...)
+{
+    va_list lp;     /* Pointer to the list of arguments. */
+    size_t bytes;   /* The number of bytes the string needs. */
+
+    /* Measuring, allocating and creating the string. */
+    va_start(lp, fmt);
+    bytes = ref_vbytesfmt(lp, fmt);
+    *sp = (char*) malloc(bytes);
+    vsprintf(*sp, fmt, lp);
+    va_end(lp);
+}
+
+/**
+ * This function prints the result of formatting one format with one path.
+ */
+void report(char* name, char* path, uint64_t ns, uint64_t n)
+{
+    char label[64];     /* The name of the result. */
+
+    /* Naming the result after the format and the path. */
+    snprintf(label, sizeof(label), "%s: %s", name, path);
+    bench_report(label, ns, n, 0);
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t n;             /* The number of strings per path. */
+    const char* tstamp;     /* A time stamp to format. */
+    char cmd[512];          /* A long command to format. */
+    char* str;              /* The string formatted by strfmt(). */
+    arena a;                /* The arena astrfmt() formats into. */
+    strbuf sb;              /* The builder strbuf_fmt() formats into. */
+    char buf[STRFMT_STACK_LEN];     /* The builder's stack buffer. */
+    char* dir = "/usr/local/bin:/usr/bin:/bin";     /* A PATH entry. */
+    uint64_t bytes = 0;     /* The number of bytes formatted. */
+    uint64_t t;             /* When the current path started. */
+    uint64_t i;             /* Index of the current string. */
+
+    n = bench_arg(argc, argv, 1, 2) * 1000000;
+    tstamp = timestamp();
+    memset(cmd, 'x', sizeof(cmd) - 1);
+    cmd[sizeof(cmd) - 1] = '\0';
+    arena_init(&a, 0);
+    strbuf_init(&sb, buf, sizeof(buf));
+
+    /* The status messages of main.c and launch(). */
+    BENCH_FMT("status", n, "[ %s ] Sub-process is running...\n", tstamp);
+    BENCH_FMT("created", n,
+              "[ %s ] Sub-process created... Executing command...\n",
+              tstamp);
+
+    /* The output file names of mkfname(). */
+    BENCH_FMT("fname", n, "%s%s_%lu%s", "./output/", "lsla", 42UL,
+              "_out.txt");
+
+    /* The cgroup path of subproc_setcgroup(). */
+    BENCH_FMT("cgroup", n, "%s/subproc-%d-%lu",
+              "/sys/fs/cgroup/subproc.slice", 12345, 7UL);
+
+    /* The executable paths of resolve(). */
+    BENCH_FMT("resolve", n, "%.*s/%s", 12, dir, "sh");
+
+    /* A command too long for the stack buffers. */
+    BENCH_FMT("long", n, "%s", cmd);
+
+    strbuf_free(&sb);
+    arena_free(&a);
+
+    /* Using the results keeps the loops from being optimised away. */
+    return (bytes > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
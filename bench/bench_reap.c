@@ -0,0 +1,238 @@
+/**
+ * bench_reap.c
+ *
+ * This file benchmarks how long it takes to reap many sub-processes that exit
+ * at once with subproc_watch(), which waits on a pidfd per sub-process, against
+ * a SIGCHLD signalfd with a waitpid() loop, and against polling waitpid() with
+ * a sleep(1) between rounds as subproc_term() once did.
+ *
+ * Usage: bench_reap [children]
+ * 1000 children are used by default. They all read one pipe, and the clock
+ * starts when the parent closes it and they all see the end of it.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#define _GNU_SOURCE
+
+#include <spawn.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This function creates the pipe the children read, exiting on failure.
+ */
+void mkgate(int fds[2])
+{
+    /* Creating the pipe. */
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        fprintf(stderr, "[ %s ] ERROR: In mkgate(): pipe2() - %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * This function launches cat(1) reading the file descriptor in, with its
+ * output sent to null, without the library, and returns its process id.
+ */
+pid_t spawncat(int in, int null)
+{
+    posix_spawn_file_actions_t fa;  /* What the child does before exec. */
+    char* argv[] = { "cat", NULL }; /* The arguments of the child. */
+    pid_t pid;                      /* The process id of the child. */
+    int err;                        /* The error posix_spawn() returned. */
+
+    /* Launching the child with its descriptors in place. */
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, in, STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, null, STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, null, STDERR_FILENO);
+    if ((err = posix_spawnp(&pid, "cat", &fa, NULL, argv, environ)) != 0)
+    {
+        fprintf(stderr, "[ %s ] ERROR: In spawncat(): posix_spawnp() - %s\n",
+                timestamp(), strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    posix_spawn_file_actions_destroy(&fa);
+
+    return pid;
+}
+
+/**
+ * This function reaps n children by polling each with waitpid() and sleeping
+ * for a second between rounds, and returns how long it took from the gate
+ * being closed.
+ */
+uint64_t run_poll(uint64_t n, int null)
+{
+    int gate[2];        /* The pipe the children read. */
+    pid_t* pids;        /* The children. */
+    uint64_t left;      /* The number of children not reaped yet. */
+    uint64_t t;         /* When the gate was closed. */
+    uint64_t i;         /* Index of the current child. */
+
+    /* Launching the children. */
+    mkgate(gate);
+    pids = malloc(n * sizeof(pid_t));
+    for (i = 0; i < n; i++)
+        pids[i] = spawncat(gate[0], null);
+    closefd(gate[0]);
+
+    /* Letting them exit and polling until they have all been reaped. */
+    t = mono_now();
+    closefd(gate[1]);
+    for (left = n; ; sleep(1))
+    {
+        for (i = 0; i < n; i++)
+            if (pids[i] != -1 && waitpid(pids[i], NULL, WNOHANG) == pids[i])
+            {
+                pids[i] = -1;
+                left--;
+            }
+        if (left == 0)
+            break;
+    }
+    t = mono_now() - t;
+    free(pids);
+
+    return t;
+}
+
+/**
+ * This function reaps n children through a SIGCHLD signalfd in an epoll set,
+ * calling waitpid() until it finds no more after each signal, and returns how
+ * long it took from the gate being closed.
+ */
+uint64_t run_sigchld(uint64_t n, int null)
+{
+    int gate[2];                /* The pipe the children read. */
+    sigset_t mask;              /* SIGCHLD. */
+    sigset_t old;               /* The signal mask before. */
+    int sfd;                    /* The signalfd. */
+    int efd;                    /* The epoll set. */
+    struct epoll_event ee;      /* The signalfd's event. */
+    struct signalfd_siginfo si; /* A signal read from the signalfd. */
+    uint64_t left;              /* The number of children not reaped yet. */
+    uint64_t t;                 /* When the gate was closed. */
+    uint64_t i;                 /* Index of the current child. */
+
+    /* Receiving SIGCHLD through a signalfd watched by epoll. */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &old);
+    sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    efd = epoll_create1(EPOLL_CLOEXEC);
+    ee.events = EPOLLIN;
+    ee.data.fd = sfd;
+    epoll_ctl(efd, EPOLL_CTL_ADD, sfd, &ee);
+
+    /* Launching the children. */
+    mkgate(gate);
+    for (i = 0; i < n; i++)
+        spawncat(gate[0], null);
+    closefd(gate[0]);
+
+    /* Letting them exit and reaping them as the signals arrive. */
+    t = mono_now();
+    closefd(gate[1]);
+    for (left = n; left > 0; )
+    {
+        if (epoll_wait(efd, &ee, 1, -1) != 1)
+            continue;
+        while (read(sfd, &si, sizeof(si)) == sizeof(si))
+            ;
+        while (left > 0 && waitpid(-1, NULL, WNOHANG) > 0)
+            left--;
+    }
+    t = mono_now() - t;
+
+    closefd(efd);
+    closefd(sfd);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+
+    return t;
+}
+
+/**
+ * This function reaps n children launched by the library, watching each with
+ * a pidfd of its own, and returns how long it took from the gate being
+ * closed. Registering the pidfds is timed, as it is a cost of watching one
+ * per child.
+ */
+uint64_t run_watch(uint64_t n, int null, char* fdir)
+{
+    int gate[2];            /* The pipe the children read. */
+    char* argv[] = { "cat", NULL };     /* The arguments of the children. */
+    evloop ev;              /* The evloop the children are watched by. */
+    subproc* sps;           /* The children. */
+    uint64_t t;             /* When the gate was closed. */
+    uint64_t i;             /* Index of the current child. */
+
+    /* Launching the children, which print status messages. */
+    mkgate(gate);
+    evloop_init(&ev);
+    sps = malloc(n * sizeof(subproc));
+    bench_quiet();
+    for (i = 0; i < n; i++)
+    {
+        subproc_init(&sps[i]);
+        subproc_redirect(&sps[i], STDIN_FILENO,
+                         fcntl(gate[0], F_DUPFD_CLOEXEC, 0));
+        subproc_redirect(&sps[i], STDOUT_FILENO,
+                         fcntl(null, F_DUPFD_CLOEXEC, 0));
+        subproc_redirect(&sps[i], STDERR_FILENO,
+                         fcntl(null, F_DUPFD_CLOEXEC, 0));
+        subproc_execv(&sps[i], argv, NULL, fdir);
+    }
+    bench_loud();
+    closefd(gate[0]);
+
+    /* Letting them exit and running the evloop until they are reaped. */
+    t = mono_now();
+    closefd(gate[1]);
+    for (i = 0; i < n; i++)
+        bench_reap(&sps[i], &ev);
+    t = mono_now() - t;
+
+    for (i = 0; i < n; i++)
+        subproc_free(&sps[i]);
+    free(sps);
+    evloop_free(&ev);
+
+    return t;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t n;     /* The number of children. */
+    int null;       /* /dev/null. */
+    char* fdir;     /* The directory for the output files. */
+
+    n = bench_arg(argc, argv, 1, 1000);
+    null = openfd("/dev/null", O_RDWR | O_CLOEXEC, 0);
+    fdir = bench_mkdir("bench_reap");
+
+    fprintf(stdout, "Reaping %llu children that exit at once\n",
+            (unsigned long long) n);
+
+    bench_report("waitpid + sleep(1) polling", run_poll(n, null), n, 0);
+    bench_report("SIGCHLD signalfd + waitpid", run_sigchld(n, null), n, 0);
+    bench_report("subproc_watch (pidfd)", run_watch(n, null, fdir), n, 0);
+
+    bench_rmdir(fdir);
+    closefd(null);
+
+    return EXIT_SUCCESS;
+}
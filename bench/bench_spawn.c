@@ -0,0 +1,186 @@
+/**
+ * bench_spawn.c
+ *
+ * This file benchmarks launching sub-processes with subproc_exec(), which
+ * uses posix_spawn(), against the fork() it replaced, as the heap of the
+ * parent grows.
+ *
+ * Usage: bench_spawn [megabytes] [spawns]
+ * Launches 200 sub-processes with each path at heaps of up to 1024 MB by
+ * default. Only the time the parent spends launching is counted; reaping is
+ * left out of it.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include <sys/wait.h>
+
+#include "bench.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This is the command that is launched.
+ */
+#define BENCH_CMD "true"
+
+/**
+ * This function launches the command provided to it in the way
+ * subproc_exec() did before it used posix_spawn(): the parent forks and the
+ * child names and opens its own output files before it executes the command.
+ * The process id of the child is returned.
+ */
+pid_t ref_exec(char* cmd, char* fdir)
+{
+    pid_t pid;          /* The process id of the child. */
+    FILE* fout;         /* The file stream for stdout. */
+    FILE* ferr;         /* The file stream for stderr. */
+    char* fname_out;    /* The file name for the stdout file stream. */
+    char* fname_err;    /* The file name for the stderr file stream. */
+
+    /* Create the child process. */
+    if ((pid = fork()) == -1)
+    {
+        fprintf(stderr, "[ %s ] ERROR: In ref_exec(): fork() - %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    else if (pid == 0)  /* The child process. */
+    {
+        /* Print status message. */
+        fprintf(stdout, "[ %s ] Creating sub-process...\n", timestamp());
+
+        /* Create the file names for the output information. */
+        strfmt(&fname_out, "%s%s%s", fdir, cmd, "_out.txt");
+        strfmt(&fname_err, "%s%s%s", fdir, cmd, "_err.txt");
+
+        /* Open the file streams and make them stdout and stderr. */
+        fout = openfs(fname_out, "w");
+        ferr = openfs(fname_err, "w");
+        dup2(fileno(fout), STDOUT_FILENO);
+        dup2(fileno(ferr), STDERR_FILENO);
+        closefs(fout);
+        closefs(ferr);
+        free(fname_out);
+        free(fname_err);
+
+        /* Execute the command as the child process. */
+        execl("/bin/sh", "sh", "-c", cmd, NULL);
+        _exit(127);
+    }
+
+    return pid;
+}
+
+/**
+ * This function launches spawns sub-processes with the fork() path, reaping
+ * each before the next, and returns the nanoseconds spent launching them.
+ */
+uint64_t run_fork(char* fdir, uint64_t spawns)
+{
+    uint64_t ns = 0;    /* The time spent launching. */
+    uint64_t t;         /* When the current launch started. */
+    pid_t pid;          /* The current child. */
+    uint64_t i;         /* Index of the current launch. */
+
+    /* Launching and reaping each child. */
+    for (i = 0; i < spawns; i++)
+    {
+        t = mono_now();
+        pid = ref_exec(BENCH_CMD, fdir);
+        ns += mono_now() - t;
+        waitpid(pid, NULL, 0);
+    }
+
+    return ns;
+}
+
+/**
+ * This function launches spawns sub-processes with subproc_exec(), reaping
+ * each through an evloop before the next, and returns the nanoseconds spent
+ * launching them.
+ */
+uint64_t run_spawn(char* fdir, uint64_t spawns)
+{
+    uint64_t ns = 0;    /* The time spent launching. */
+    uint64_t t;         /* When the current launch started. */
+    evloop ev;          /* The evloop the children are reaped by. */
+    subproc sp;         /* The current child. */
+    uint64_t i;         /* Index of the current launch. */
+
+    /* Launching and reaping each child. */
+    evloop_init(&ev);
+    for (i = 0; i < spawns; i++)
+    {
+        subproc_init(&sp);
+        t = mono_now();
+        subproc_exec(&sp, BENCH_CMD, fdir);
+        ns += mono_now() - t;
+        bench_reap(&sp, &ev);
+        subproc_free(&sp);
+    }
+    evloop_free(&ev);
+
+    return ns;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t max;           /* The largest heap in megabytes. */
+    uint64_t spawns;        /* The number of launches per path. */
+    uint64_t sizes[4];      /* The heaps launched from, in megabytes. */
+    char* heap = NULL;      /* The heap. */
+    char* fdir;             /* The directory for the output files. */
+    char name[64];          /* The name of the current result. */
+    uint64_t ns;            /* The time spent launching. */
+    int i;                  /* Index of the current heap size. */
+
+    max = bench_arg(argc, argv, 1, 1024);
+    spawns = bench_arg(argc, argv, 2, 200);
+    sizes[0] = 0;
+    sizes[1] = max / 16;
+    sizes[2] = max / 4;
+    sizes[3] = max;
+    fdir = bench_mkdir("bench_spawn");
+
+    fprintf(stdout, "Launching \"%s\" %llu times per path\n", BENCH_CMD,
+            (unsigned long long) spawns);
+
+    for (i = 0; i < 4; i++)
+    {
+        /* Grow the heap and touch every page, so it is resident and the
+         * fork() has to copy its page tables. */
+        free(heap);
+        heap = NULL;
+        if (sizes[i] > 0)
+        {
+            heap = malloc(sizes[i] << 20);
+            memset(heap, 1, sizes[i] << 20);
+        }
+        fprintf(stdout, "RSS %llu kB\n", (unsigned long long) bench_rss_kb());
+
+        /* Both paths print status messages. */
+        bench_quiet();
+        ns = run_fork(fdir, spawns);
+        bench_loud();
+        snprintf(name, sizeof(name), "fork (%llu MB heap)",
+                 (unsigned long long) sizes[i]);
+        bench_report(name, ns, spawns, 0);
+
+        bench_quiet();
+        ns = run_spawn(fdir, spawns);
+        bench_loud();
+        snprintf(name, sizeof(name), "subproc_exec (%llu MB heap)",
+                 (unsigned long long) sizes[i]);
+        bench_report(name, ns, spawns, 0);
+    }
+
+    free(heap);
+    bench_rmdir(fdir);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**
+ * bench_splice.c
+ *
+ * This file benchmarks moving the output of a sub-process to files with
+ * subproc_stream(), which uses splice() and tee(), against copying it through
+ * a buffer with read() and write(), and against the file redirect that
+ * subproc_exec() sets up by default.
+ *
+ * Usage: bench_splice [megabytes]
+ * Each path moves 1024 MB of output from head(1) by default. The CPU time of
+ * the parent is printed under each path, as that is what splice() saves; the
+ * wall time is bound by the child and the file system as well.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#define _GNU_SOURCE
+
+#include "bench.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This is the size of the buffer the read() and write() copy uses.
+ */
+#define BENCH_BUF 65536
+
+/**
+ * This function opens a file in fdir named name for the output of a path.
+ */
+int opensink(char* fdir, char* name)
+{
+    char* fname;    /* The path of the file. */
+    int fd;         /* The file. */
+
+    /* Opening the file empty. */
+    strfmt(&fname, "%s%s", fdir, name);
+    fd = openfd(fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    free(fname);
+
+    return fd;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t total;         /* The number of bytes moved per path. */
+    char cmd[64];           /* The command that writes them. */
+    char* fdir;             /* The directory for the output files. */
+    evloop ev;              /* The evloop the sub-processes are watched by. */
+    subproc sp;             /* The current sub-process. */
+    int fds[2];             /* The pipe the read() and write() copy uses. */
+    int fd;                 /* The file written to. */
+    int fd2;                /* The second file written to. */
+    char* buf;              /* The buffer the read() and write() copy uses. */
+    ssize_t n;              /* The number of bytes read. */
+    uint64_t t;             /* When the current path started. */
+    uint64_t cpu;           /* The CPU time of the parent when it started. */
+
+    total = bench_arg(argc, argv, 1, 1024) * 1024 * 1024;
+    snprintf(cmd, sizeof(cmd), "head -c %llu /dev/zero",
+             (unsigned long long) total);
+    fdir = bench_mkdir("bench_splice");
+    buf = malloc(BENCH_BUF);
+    evloop_init(&ev);
+
+    fprintf(stdout, "Moving %llu MB of output to files in %s\n",
+            (unsigned long long) (total >> 20), fdir);
+
+    /* The child writes to the file itself, as subproc_exec() sets up. */
+    bench_quiet();
+    subproc_init(&sp);
+    t = mono_now();
+    cpu = bench_cpu_ns();
+    subproc_exec(&sp, cmd, fdir);
+    bench_reap(&sp, &ev);
+    t = mono_now() - t;
+    cpu = bench_cpu_ns() - cpu;
+    subproc_free(&sp);
+    bench_loud();
+    bench_report("file redirect", t, 0, total);
+    bench_report("  parent CPU", cpu, 0, 0);
+
+    /* The parent copies a pipe to the file through a buffer. */
+    bench_quiet();
+    subproc_init(&sp);
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        fprintf(stderr, "[ %s ] ERROR: In main(): pipe2() - %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    fd = opensink(fdir, "copy.txt");
+    t = mono_now();
+    cpu = bench_cpu_ns();
+    subproc_redirect(&sp, STDOUT_FILENO, fds[1]);
+    subproc_exec(&sp, cmd, fdir);
+    while ((n = read(fds[0], buf, BENCH_BUF)) > 0)
+        writefd(fd, buf, (size_t) n);
+    bench_reap(&sp, &ev);
+    t = mono_now() - t;
+    cpu = bench_cpu_ns() - cpu;
+    subproc_free(&sp);
+    closefd(fds[0]);
+    closefd(fd);
+    bench_loud();
+    bench_report("read/write", t, 0, total);
+    bench_report("  parent CPU", cpu, 0, 0);
+
+    /* The parent splices the pipe to the file. */
+    bench_quiet();
+    subproc_init(&sp);
+    fd = opensink(fdir, "splice.txt");
+    t = mono_now();
+    cpu = bench_cpu_ns();
+    subproc_stream(&sp, STDOUT_FILENO, fd);
+    subproc_exec(&sp, cmd, fdir);
+    bench_reap(&sp, &ev);
+    t = mono_now() - t;
+    cpu = bench_cpu_ns() - cpu;
+    subproc_free(&sp);
+    closefd(fd);
+    bench_loud();
+    bench_report("subproc_stream (splice)", t, 0, total);
+    bench_report("  parent CPU", cpu, 0, 0);
+
+    /* The parent tees the pipe to one file and splices it to another. */
+    bench_quiet();
+    subproc_init(&sp);
+    fd = opensink(fdir, "tee1.txt");
+    fd2 = opensink(fdir, "tee2.txt");
+    t = mono_now();
+    cpu = bench_cpu_ns();
+    subproc_stream(&sp, STDOUT_FILENO, fd);
+    subproc_stream(&sp, STDOUT_FILENO, fd2);
+    subproc_exec(&sp, cmd, fdir);
+    bench_reap(&sp, &ev);
+    t = mono_now() - t;
+    cpu = bench_cpu_ns() - cpu;
+    subproc_free(&sp);
+    closefd(fd);
+    closefd(fd2);
+    bench_loud();
+    bench_report("subproc_stream (tee, 2 files)", t, 0, total);
+    bench_report("  parent CPU", cpu, 0, 0);
+
+    evloop_free(&ev);
+    free(buf);
+    bench_rmdir(fdir);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,155 @@
+/**
+ * bench_str.c
+ *
+ * This file benchmarks removing the chars mkfname() removes from command
+ * lines with sdelchars() against the sdelchar() and sdelelem() it replaced.
+ *
+ * Usage: bench_str [longest]
+ * Command lines of 64 chars up to 4096 chars are used by default. The
+ * replaced functions are quadratic, so they are run fewer times on longer
+ * lines; every result is per line.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "bench.h"
+
+/**
+ * This is the path that the command lines are made of.
+ */
+#define BENCH_PATH "/usr/local/bin/tool --input=./data/file.txt "
+
+/**
+ * This is the number of chars handled per length by each path, which sets
+ * how many times each line is edited.
+ */
+#define BENCH_CHARS (1 << 24)
+
+/**
+ * This function removes the char at index elem from the string provided to
+ * it, as sdelelem() did before it was replaced: the string is split into two
+ * new strings and rebuilt. The baseline copied the second part to the wrong
+ * indices, writing past the end of its buffer; this copy puts it at the start
+ * of the buffer so it can be run, and is otherwise the same.
+ */
+void ref_sdelelem(char** sp, unsigned elem)
+{
+    char* to_elem;      /* Chars from start of string to element to delete. */
+    char* from_elem;    /* Chars from element to delete to end of string. */
+    unsigned c;         /* The current char in the string. */
+
+    /* Allocating memory. */
+    to_elem     = (char*) malloc(sizeof(char) * (elem + 1));
+    from_elem   = (char*) malloc(sizeof(char) * (strlen(*sp) - elem));
+
+    /* Storing the two sections of the string. */
+    for (c = 0; c < strlen(*sp); c++)
+    {
+        if (c < elem)
+            to_elem[c] = (*sp)[c];
+        if (c > elem)
+            from_elem[c - elem - 1] = (*sp)[c];
+    }
+    to_elem[elem] = '\0';
+    from_elem[strlen(*sp) - elem - 1] = '\0';
+
+    /* Recreating the string. */
+    free(*sp);
+    strfmt(sp, "%s%s", to_elem, from_elem);
+
+    /* Cleaning up. */
+    free(to_elem);
+    free(from_elem);
+}
+
+/**
+ * This function removes all cases of the char provided from the string, as
+ * sdelchar() did before it was replaced.
+ */
+void ref_sdelchar(char** sp, char remove)
+{
+    unsigned c;     /* Index of current char in the string. */
+
+    /* Removing the unwanted characters. */
+    for (c = 0; c < strlen(*sp); c++)
+    {
+        if ((*sp)[c] == remove)
+        {
+            ref_sdelelem(sp, c);
+
+            /* Checking the char that replaced the removed one. */
+            c--;
+        }
+    }
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    size_t longest;         /* The length of the longest command line. */
+    size_t len;             /* The length of the current command line. */
+    char* line;             /* The command line. */
+    char* str;              /* The copy being edited. */
+    char name[64];          /* The name of the current result. */
+    size_t kept = 0;        /* The sum of the edited lengths. */
+    uint64_t reps;          /* The number of edits of the current line. */
+    uint64_t t;             /* When the current path started. */
+    uint64_t i;             /* Index of the current edit. */
+
+    longest = bench_arg(argc, argv, 1, 4096);
+
+    for (len = 64; len <= longest; len *= 4)
+    {
+        /* Making a command line of the current length. */
+        line = malloc(len + 1);
+        for (i = 0; i < len; i++)
+            line[i] = BENCH_PATH[i % (sizeof(BENCH_PATH) - 1)];
+        line[len] = '\0';
+        str = malloc(len + 1);
+
+        /* The replaced functions, which rebuild the string for every char
+         * removed. */
+        reps = BENCH_CHARS / len / len + 1;
+        for (t = mono_now(), i = 0; i < reps; i++)
+        {
+            str = strcpy(realloc(str, len + 1), line);
+            ref_sdelchar(&str, '/');
+            ref_sdelchar(&str, '.');
+            kept += strlen(str);
+        }
+        snprintf(name, sizeof(name), "sdelchar (%zu chars)", len);
+        bench_report(name, mono_now() - t, reps, len * reps);
+
+        /* The current sdelchar(), one char at a time. The replaced functions
+         * left a shorter string behind. */
+        str = realloc(str, len + 1);
+        reps = BENCH_CHARS / len;
+        for (t = mono_now(), i = 0; i < reps; i++)
+        {
+            memcpy(str, line, len + 1);
+            sdelchar(&str, '/');
+            sdelchar(&str, '.');
+            kept += strlen(str);
+        }
+        snprintf(name, sizeof(name), "sdelchar, in place (%zu chars)", len);
+        bench_report(name, mono_now() - t, reps, len * reps);
+
+        /* sdelchars(), as mkfname() uses it. */
+        for (t = mono_now(), i = 0; i < reps; i++)
+        {
+            memcpy(str, line, len + 1);
+            kept += sdelchars(str, "/.");
+        }
+        snprintf(name, sizeof(name), "sdelchars (%zu chars)", len);
+        bench_report(name, mono_now() - t, reps, len * reps);
+
+        free(str);
+        free(line);
+    }
+
+    /* Using the results keeps the loops from being optimised away. */
+    return (kept > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
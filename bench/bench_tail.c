@@ -0,0 +1,131 @@
+/**
+ * bench_tail.c
+ *
+ * This file benchmarks keeping the end of a long stream of output with
+ * subproc_keeptail(), which keeps it in a fixed size ring buffer, against
+ * capturing all of it in a growing buffer with subproc_capture() and against
+ * writing it to a file and reading the end back.
+ *
+ * Usage: bench_tail [megabytes] [kilobytes]
+ * Each path keeps the last 64 KB of 256 MB of output from head(1) by default.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "bench.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This is the number of snapshots taken to time subproc_tail().
+ */
+#define BENCH_SNAPS 1000
+
+/**
+ * This function prints the resident set size of the program after a path.
+ */
+void report_rss(uint64_t before)
+{
+    uint64_t rss = bench_rss_kb();  /* The resident set size now. */
+
+    /* Printing how much it grew. */
+    fprintf(stdout, "  RSS %llu kB (+%llu kB)\n", (unsigned long long) rss,
+            (unsigned long long) ((rss > before) ? rss - before : 0));
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t total;         /* The number of bytes written per path. */
+    size_t size;            /* The number of bytes of the tail. */
+    char cmd[64];           /* The command that writes them. */
+    char* fdir;             /* The directory for the output files. */
+    char* fname;            /* The output file of the file path. */
+    evloop ev;              /* The evloop the sub-processes are watched by. */
+    subproc sp;             /* The current sub-process. */
+    char* buf;              /* The tail. */
+    size_t len;             /* The length of the tail. */
+    int fd;                 /* The output file. */
+    uint64_t rss;           /* The resident set size before a path. */
+    uint64_t t;             /* When the current path started. */
+    int i;                  /* Index of the current snapshot. */
+
+    total = bench_arg(argc, argv, 1, 256) * 1024 * 1024;
+    size = bench_arg(argc, argv, 2, 64) * 1024;
+    snprintf(cmd, sizeof(cmd), "head -c %llu /dev/zero",
+             (unsigned long long) total);
+    fdir = bench_mkdir("bench_tail");
+    buf = malloc(size);
+    evloop_init(&ev);
+
+    fprintf(stdout, "Keeping the last %zu kB of %llu MB of output\n",
+            size >> 10, (unsigned long long) (total >> 20));
+
+    /* The ring buffer, which stays the same size. */
+    rss = bench_rss_kb();
+    bench_quiet();
+    subproc_init(&sp);
+    t = mono_now();
+    subproc_keeptail(&sp, size);
+    subproc_exec(&sp, cmd, fdir);
+    bench_reap(&sp, &ev);
+    len = subproc_tail(&sp, STDOUT_FILENO, buf, size);
+    t = mono_now() - t;
+    bench_loud();
+    bench_report("subproc_keeptail", t, 0, total);
+    report_rss(rss);
+
+    /* Taking snapshots of the ring, as a crash handler would. */
+    t = mono_now();
+    for (i = 0; i < BENCH_SNAPS; i++)
+        len += subproc_tail(&sp, STDOUT_FILENO, buf, size);
+    bench_report("  subproc_tail", mono_now() - t, BENCH_SNAPS,
+                 (uint64_t) size * BENCH_SNAPS);
+    subproc_free(&sp);
+
+    /* A file, with the end read back from it. */
+    rss = bench_rss_kb();
+    bench_quiet();
+    subproc_init(&sp);
+    strfmt(&fname, "%s%s", fdir, "tail.txt");
+    t = mono_now();
+    subproc_redirect(&sp, STDOUT_FILENO,
+                     openfd(fname, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+                            0644));
+    subproc_exec(&sp, cmd, fdir);
+    bench_reap(&sp, &ev);
+    fd = openfd(fname, O_RDONLY | O_CLOEXEC, 0);
+    len = pread(fd, buf, size, (total > size) ? total - size : 0);
+    closefd(fd);
+    t = mono_now() - t;
+    bench_loud();
+    bench_report("file", t, 0, total);
+    report_rss(rss);
+    subproc_free(&sp);
+    free(fname);
+
+    /* Everything, in a buffer that grows with the output. */
+    rss = bench_rss_kb();
+    bench_quiet();
+    subproc_init(&sp);
+    t = mono_now();
+    subproc_capture(&sp, 0);
+    subproc_exec(&sp, cmd, fdir);
+    bench_reap(&sp, &ev);
+    subproc_out(&sp, &len);
+    t = mono_now() - t;
+    bench_loud();
+    bench_report("subproc_capture", t, 0, total);
+    report_rss(rss);
+    subproc_free(&sp);
+
+    evloop_free(&ev);
+    free(buf);
+    bench_rmdir(fdir);
+
+    /* Using the results keeps the loops from being optimised away. */
+    return (len > 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
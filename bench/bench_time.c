@@ -0,0 +1,92 @@
+/**
+ * bench_time.c
+ *
+ * This file benchmarks the cost of one deadline check with the monotonic time
+ * functions of mycutils against the CLOCK_REALTIME check_timer() they
+ * replaced.
+ *
+ * Usage: bench_time [millions]
+ * Each check is made 20 million times by default, against a deadline an hour
+ * away so that every check has to read the clock.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "bench.h"
+
+/**
+ * This is how far away the deadline is, in nanoseconds.
+ */
+#define BENCH_WAIT (3600ULL * NANOS_PER_SEC)
+
+/**
+ * This function returns true if wait_time nanoseconds have elapsed since
+ * start on the real time clock, as check_timer() did before it was replaced.
+ */
+bool ref_check_timer(struct timespec start, uint64_t wait_time)
+{
+    struct timespec current;    /* The current time. */
+    struct timespec elapsed;    /* The time elapsed since start. */
+
+    /* Obtaining the current time. */
+    clock_gettime(CLOCK_REALTIME, &current);
+
+    /* Calculating the elapsed time. */
+    elapsed.tv_sec = current.tv_sec - start.tv_sec;
+    elapsed.tv_nsec = current.tv_nsec - start.tv_nsec;
+
+    /* Checking whether the time has elapsed. */
+    return (uint64_t) ((elapsed.tv_sec * NANOS_PER_SEC) + elapsed.tv_nsec)
+           >= wait_time;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    uint64_t n;             /* The number of checks per path. */
+    struct timespec start;  /* When the check_timer() timers started. */
+    uint64_t deadline;      /* The deadline of the monotonic checks. */
+    uint64_t passed;        /* The number of checks that passed. */
+    uint64_t sum;           /* The sum of the clock reads. */
+    uint64_t t;             /* When the current path started. */
+    uint64_t i;             /* Index of the current check. */
+
+    n = bench_arg(argc, argv, 1, 20) * 1000000;
+
+    fprintf(stdout, "Making %llu checks per path\n", (unsigned long long) n);
+
+    /* The replaced check, on the real time clock. */
+    clock_gettime(CLOCK_REALTIME, &start);
+    for (t = mono_now(), passed = 0, i = 0; i < n; i++)
+        passed += ref_check_timer(start, BENCH_WAIT);
+    bench_report("check_timer (CLOCK_REALTIME)", mono_now() - t, n, 0);
+
+    /* The current check_timer(), on the monotonic clock. */
+    start_timer(&start);
+    for (t = mono_now(), i = 0; i < n; i++)
+        passed += check_timer(start, BENCH_WAIT);
+    bench_report("check_timer", mono_now() - t, n, 0);
+
+    /* The clocks alone. */
+    for (t = mono_now(), sum = 0, i = 0; i < n; i++)
+        sum += mono_now();
+    bench_report("mono_now", mono_now() - t, n, 0);
+    for (t = mono_now(), i = 0; i < n; i++)
+        sum += mono_coarse();
+    bench_report("mono_coarse", mono_now() - t, n, 0);
+
+    /* The deadline checks. */
+    deadline = deadline_in(BENCH_WAIT);
+    for (t = mono_now(), i = 0; i < n; i++)
+        passed += deadline_passed(deadline);
+    bench_report("deadline_passed", mono_now() - t, n, 0);
+    for (t = mono_now(), i = 0; i < n; i++)
+        passed += deadline_passed_coarse(deadline);
+    bench_report("deadline_passed_coarse", mono_now() - t, n, 0);
+
+    /* Using the results keeps the loops from being optimised away. */
+    return (passed == 0 && sum != 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,135 @@
+/**
+ * bench_write.c
+ *
+ * This file benchmarks writing log lines with the bulk writers and output
+ * buffer of mycutils against the character at a time writefss() they
+ * replaced.
+ *
+ * Usage: bench_write [megabytes] [file]
+ * Writes 1024 MB of log lines to /dev/null through each path by default.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "bench.h"
+
+/**
+ * This is the number of lines handed to writev() at once.
+ */
+#define BENCH_IOV 64
+
+/**
+ * This function writes the char provided to it to the file stream, as
+ * writefsc() did before it was replaced.
+ */
+void ref_writefsc(FILE* fs, char ch)
+{
+    /* Writing the char to the file stream. */
+    fprintf(fs, "%c", ch);
+}
+
+/**
+ * This function writes the string provided to it to the file stream, as
+ * writefss() did before it was replaced: a char at a time, measuring the
+ * string for every char.
+ */
+void ref_writefss(FILE* fs, char* str)
+{
+    size_t c;   /* Index of the current char in the string. */
+
+    /* Writing the string to the file stream. */
+    for (c = 0; c < strlen(str); c++)
+        ref_writefsc(fs, str[c]);
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    char* path;             /* The file written to. */
+    uint64_t total;         /* The number of bytes to write. */
+    char lines[BENCH_IOV][128];         /* The log lines. */
+    size_t lens[BENCH_IOV];             /* The lengths of the lines. */
+    struct iovec iov[BENCH_IOV];        /* The lines, for writev(). */
+    FILE* fs;               /* The file as a stream. */
+    outbuf ob;              /* The output buffer. */
+    int fd;                 /* The file as a file descriptor. */
+    uint64_t written;       /* The number of bytes written. */
+    uint64_t nlines;        /* The number of lines written. */
+    uint64_t t;             /* When the current path started. */
+    int i;                  /* Index of the current line. */
+
+    total = bench_arg(argc, argv, 1, 1024) * 1024 * 1024;
+    path = (argc > 2) ? argv[2] : "/dev/null";
+
+    /* Make lines that look like the ones the library logs. */
+    for (i = 0; i < BENCH_IOV; i++)
+    {
+        lens[i] = (size_t) snprintf(lines[i], sizeof(lines[i]),
+                    "[ %s ] Sub-process %d created... Executing command...\n",
+                    timestamp(), i);
+        iov[i].iov_base = lines[i];
+        iov[i].iov_len = lens[i];
+    }
+
+    fprintf(stdout, "Writing %llu MB of log lines to %s\n",
+            (unsigned long long) (total >> 20), path);
+
+    /* The replaced writer: a printf per char. */
+    fs = openfs(path, "w");
+    for (t = mono_now(), written = 0, nlines = 0; written < total; nlines++)
+    {
+        ref_writefss(fs, lines[nlines % BENCH_IOV]);
+        written += lens[nlines % BENCH_IOV];
+    }
+    closefs(fs);
+    bench_report("writefss (per char)", mono_now() - t, nlines, written);
+
+    /* The current string writer. */
+    fs = openfs(path, "w");
+    for (t = mono_now(), written = 0, nlines = 0; written < total; nlines++)
+    {
+        writefss(fs, lines[nlines % BENCH_IOV]);
+        written += lens[nlines % BENCH_IOV];
+    }
+    closefs(fs);
+    bench_report("writefss", mono_now() - t, nlines, written);
+
+    /* Writes whose length is known. */
+    fs = openfs(path, "w");
+    for (t = mono_now(), written = 0, nlines = 0; written < total; nlines++)
+    {
+        writefsn(fs, lines[nlines % BENCH_IOV], lens[nlines % BENCH_IOV]);
+        written += lens[nlines % BENCH_IOV];
+    }
+    closefs(fs);
+    bench_report("writefsn", mono_now() - t, nlines, written);
+
+    /* The output buffer, a line at a time. */
+    fd = openfd(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    outbuf_init(&ob, fd, NULL, 0);
+    for (t = mono_now(), written = 0, nlines = 0; written < total; nlines++)
+    {
+        outbuf_write(&ob, lines[nlines % BENCH_IOV], lens[nlines % BENCH_IOV]);
+        written += lens[nlines % BENCH_IOV];
+    }
+    outbuf_flush(&ob);
+    bench_report("outbuf_write", mono_now() - t, nlines, written);
+
+    /* The output buffer, many lines at a time. */
+    for (t = mono_now(), written = 0, nlines = 0; written < total;
+         nlines += BENCH_IOV)
+    {
+        outbuf_writev(&ob, iov, BENCH_IOV);
+        for (i = 0; i < BENCH_IOV; i++)
+            written += lens[i];
+    }
+    outbuf_flush(&ob);
+    bench_report("outbuf_writev", mono_now() - t, nlines, written);
+    outbuf_free(&ob);
+    closefd(fd);
+
+    return EXIT_SUCCESS;
+}
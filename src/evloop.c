@@ -0,0 +1,420 @@
+/**
+ * evloop.c
+ *
+ * This file contains the internal data and function definitions for the
+ * evloop type.
+ *
+ * The evloop type waits for events on file descriptors with epoll and calls
+ * the functions that were registered for them.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "evloop.h"
+
+/**
+ * This is the maximum number of events that are collected per epoll_wait().
+ */
+#define EVLOOP_MAX_EVENTS 256
+
+/**
+ * This is what is registered for a file descriptor.
+ */
+struct evloop_handler {
+    evloop_fdfn fn; /* The function to call, or NULL if not registered. */
+    void* arg;      /* The argument to pass to the function. */
+    uint32_t gen;   /* Which registration of the fd this is. */
+};
+
+/**
+ * This is the internal data contained within the evloop_timer type.
+ */
+struct evloop_timer_data {
+    uint64_t deadline;  /* When the timer expires, from mono_now(). */
+    uint64_t interval;  /* How often the timer repeats, or 0. */
+    evloop_timerfn fn;  /* The function to call. */
+    void* arg;          /* The argument to pass to the function. */
+    size_t index;       /* Where the timer is in the heap. */
+    bool firing;        /* Whether the timer's function is running. */
+    bool removed;       /* Whether the timer was removed while firing. */
+    evloop_timer self;  /* This timer, handed to its function. */
+};
+
+/**
+ * This is the internal data contained within the evloop type.
+ */
+struct evloop_data {
+    int epfd;                           /* The epoll file descriptor. */
+    struct evloop_handler* handlers;    /* The handlers, indexed by fd. */
+    size_t cap;                         /* Number of handler slots. */
+    size_t nfds;                        /* Number of registered fds. */
+    int tfd;                            /* The timerfd, or -1. */
+    evloop_timer* heap;                 /* The timers, soonest first. */
+    size_t ntimers;                     /* Number of timers. */
+    size_t heapcap;                     /* Number of slots in the heap. */
+};
+
+/**
+ * This function returns the epoll data for the registration of fd provided to
+ * it. The generation of the registration goes in the top half, so events that
+ * were collected for an fd that has since been closed and registered again
+ * can be told apart from those of the new registration.
+ */
+uint64_t evdata(int fd, uint32_t gen)
+{
+    return ((uint64_t) gen << 32) | (uint32_t) fd;
+}
+
+/**
+ * This function prints the error that occurred in the function named by
+ * the string provided to it, then exits the program.
+ */
+void evloop_err(char* fname)
+{
+    /* Print the error and exit the program. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In %s(): %s\n",
+            timestamp(), fname, strerror(errno));
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * This function initialises the evloop provided to it.
+ */
+void evloop_init(evloop* ev)
+{
+    /* Allocate memory to the evloop. */
+    *ev = (evloop) malloc(sizeof(struct evloop_data));
+
+    /* Create the epoll instance. */
+    if (((*ev)->epfd = epoll_create1(EPOLL_CLOEXEC)) == -1)
+        evloop_err("evloop_init");
+
+    /* There are no handlers yet. */
+    (*ev)->handlers = NULL;
+    (*ev)->cap = 0;
+    (*ev)->nfds = 0;
+
+    /* There are no timers yet. */
+    (*ev)->tfd = -1;
+    (*ev)->heap = NULL;
+    (*ev)->ntimers = 0;
+    (*ev)->heapcap = 0;
+}
+
+/**
+ * This function destroys the evloop provided to it.
+ */
+void evloop_free(evloop* ev)
+{
+    size_t i;   /* Index of the current timer. */
+
+    /* Destroy the timers. */
+    for (i = 0; i < (*ev)->ntimers; i++)
+        free((*ev)->heap[i]);
+    if ((*ev)->tfd != -1)
+        closefd((*ev)->tfd);
+
+    /* Close the epoll instance and de-allocate memory from the evloop. */
+    closefd((*ev)->epfd);
+    free((*ev)->heap);
+    free((*ev)->handlers);
+    free(*ev);
+}
+
+/**
+ * This function registers a file descriptor with the evloop.
+ */
+void evloop_addfd(evloop* ev, int fd, uint32_t events, evloop_fdfn fn,
+                                                       void* arg)
+{
+    struct epoll_event ee;  /* The event to watch for. */
+    size_t cap;             /* The new number of handler slots. */
+
+    /* Make room for the file descriptor's handler. */
+    if ((size_t) fd >= (*ev)->cap)
+    {
+        for (cap = ((*ev)->cap > 0) ? (*ev)->cap : 64; cap <= (size_t) fd;)
+            cap *= 2;
+        (*ev)->handlers = (struct evloop_handler*) realloc((*ev)->handlers,
+                                    sizeof(struct evloop_handler) * cap);
+        memset((*ev)->handlers + (*ev)->cap, 0,
+               sizeof(struct evloop_handler) * (cap - (*ev)->cap));
+        (*ev)->cap = cap;
+    }
+
+    /* Watch the file descriptor as a new registration of it. */
+    (*ev)->handlers[fd].gen++;
+    ee.events = events;
+    ee.data.u64 = evdata(fd, (*ev)->handlers[fd].gen);
+    if (epoll_ctl((*ev)->epfd, EPOLL_CTL_ADD, fd, &ee) == -1)
+        evloop_err("evloop_addfd");
+
+    /* Remember what to call. */
+    (*ev)->handlers[fd].fn = fn;
+    (*ev)->handlers[fd].arg = arg;
+    (*ev)->nfds++;
+}
+
+/**
+ * This function changes the epoll events that a registered file descriptor
+ * is being watched for.
+ */
+void evloop_modfd(evloop* ev, int fd, uint32_t events)
+{
+    struct epoll_event ee;  /* The event to watch for. */
+
+    /* Change the events. */
+    ee.events = events;
+    ee.data.u64 = evdata(fd, (*ev)->handlers[fd].gen);
+    if (epoll_ctl((*ev)->epfd, EPOLL_CTL_MOD, fd, &ee) == -1)
+        evloop_err("evloop_modfd");
+}
+
+/**
+ * This function stops the evloop from watching the file descriptor provided
+ * to it.
+ */
+void evloop_delfd(evloop* ev, int fd)
+{
+    /* Ignore file descriptors that are not registered. */
+    if ((size_t) fd >= (*ev)->cap || (*ev)->handlers[fd].fn == NULL)
+        return;
+
+    /* Stop watching the file descriptor. Events for it that have already
+     * been collected are skipped because its handler is cleared. */
+    if (epoll_ctl((*ev)->epfd, EPOLL_CTL_DEL, fd, NULL) == -1)
+        evloop_err("evloop_delfd");
+    (*ev)->handlers[fd].fn = NULL;
+    (*ev)->handlers[fd].arg = NULL;
+    (*ev)->nfds--;
+}
+
+/**
+ * This function returns the number of file descriptors registered with
+ * the evloop.
+ */
+size_t evloop_nfds(evloop* ev)
+{
+    return (*ev)->nfds;
+}
+
+/**
+ * This function swaps two timers in the heap.
+ */
+void heap_swap(struct evloop_data* ev, size_t a, size_t b)
+{
+    evloop_timer t;     /* The timer being swapped. */
+
+    t = ev->heap[a];
+    ev->heap[a] = ev->heap[b];
+    ev->heap[b] = t;
+    ev->heap[a]->index = a;
+    ev->heap[b]->index = b;
+}
+
+/**
+ * This function moves the timer at index i towards the top of the heap until
+ * its parent expires sooner.
+ */
+void heap_up(struct evloop_data* ev, size_t i)
+{
+    for (; i > 0 && ev->heap[i]->deadline < ev->heap[(i - 1) / 2]->deadline;
+           i = (i - 1) / 2)
+        heap_swap(ev, i, (i - 1) / 2);
+}
+
+/**
+ * This function moves the timer at index i towards the bottom of the heap
+ * until its children expire later.
+ */
+void heap_down(struct evloop_data* ev, size_t i)
+{
+    size_t c;   /* The child that expires sooner. */
+
+    for (; (c = i * 2 + 1) < ev->ntimers; i = c)
+    {
+        if (c + 1 < ev->ntimers &&
+            ev->heap[c + 1]->deadline < ev->heap[c]->deadline)
+            c++;
+        if (ev->heap[i]->deadline <= ev->heap[c]->deadline)
+            break;
+        heap_swap(ev, i, c);
+    }
+}
+
+/**
+ * This function adds a timer to the heap.
+ */
+void heap_push(struct evloop_data* ev, evloop_timer t)
+{
+    /* Make room for the timer. */
+    if (ev->ntimers == ev->heapcap)
+    {
+        ev->heapcap = (ev->heapcap > 0) ? ev->heapcap * 2 : 16;
+        ev->heap = (evloop_timer*) realloc(ev->heap,
+                                    sizeof(evloop_timer) * ev->heapcap);
+    }
+
+    /* Put it at the bottom and move it up. */
+    t->index = ev->ntimers;
+    ev->heap[ev->ntimers++] = t;
+    heap_up(ev, t->index);
+}
+
+/**
+ * This function removes a timer from the heap.
+ */
+void heap_remove(struct evloop_data* ev, evloop_timer t)
+{
+    size_t i = t->index;    /* Where the timer was. */
+
+    /* Replace the timer with the last one and restore the heap order. */
+    if (i != --ev->ntimers)
+    {
+        heap_swap(ev, i, ev->ntimers);
+        heap_up(ev, i);
+        heap_down(ev, i);
+    }
+}
+
+/**
+ * This function arms the timerfd for the soonest timer.
+ */
+void rearm(struct evloop_data* ev)
+{
+    settimer(ev->tfd, (ev->ntimers > 0) ? ev->heap[0]->deadline : 0, 0);
+}
+
+/**
+ * This function is called when the timerfd expires, and calls the functions
+ * of the timers that have expired.
+ */
+void on_timer(evloop* ev, int fd, uint32_t events, void* arg)
+{
+    evloop_timer t;     /* The timer that expired. */
+    uint64_t now;       /* The current time. */
+
+    /* Acknowledge the timerfd. */
+    acktimer(fd);
+
+    /* Call the functions of the timers that have expired. */
+    for (now = mono_now();
+         (*ev)->ntimers > 0 && (*ev)->heap[0]->deadline <= now;)
+    {
+        t = (*ev)->heap[0];
+        heap_remove(*ev, t);
+
+        /* Call the timer's function. */
+        t->firing = true;
+        t->fn(ev, &t->self, t->arg);
+        t->firing = false;
+
+        /* Destroy the timer, or schedule its next expiry. Expiries that were
+         * missed are skipped rather than run back to back. */
+        if (t->removed || t->interval == 0)
+            free(t);
+        else
+        {
+            for (t->deadline += t->interval; t->deadline <= now;
+                 t->deadline += t->interval);
+            heap_push(*ev, t);
+        }
+    }
+
+    /* Arm the timerfd for the next timer. */
+    rearm(*ev);
+}
+
+/**
+ * This function adds a timer to the evloop.
+ */
+evloop_timer evloop_addtimer(evloop* ev, uint64_t delay, uint64_t interval,
+                                         evloop_timerfn fn, void* arg)
+{
+    evloop_timer t;     /* The timer. */
+
+    /* Create the timerfd the first time a timer is added. It does not count
+     * as a registered file descriptor. */
+    if ((*ev)->tfd == -1)
+    {
+        (*ev)->tfd = mktimer();
+        evloop_addfd(ev, (*ev)->tfd, EPOLLIN, on_timer, NULL);
+        (*ev)->nfds--;
+    }
+
+    /* Create the timer. */
+    t = (evloop_timer) malloc(sizeof(struct evloop_timer_data));
+    t->deadline = mono_now() + delay;
+    t->interval = interval;
+    t->fn = fn;
+    t->arg = arg;
+    t->firing = false;
+    t->removed = false;
+    t->self = t;
+
+    /* Add it to the heap, arming the timerfd if it is now the soonest. */
+    heap_push(*ev, t);
+    if (t->index == 0)
+        rearm(*ev);
+
+    return t;
+}
+
+/**
+ * This function removes a timer from the evloop and destroys it.
+ */
+void evloop_deltimer(evloop* ev, evloop_timer* t)
+{
+    /* A timer whose function is running is destroyed once it returns. */
+    if ((*t)->firing)
+    {
+        (*t)->removed = true;
+        return;
+    }
+
+    /* Remove the timer from the heap and destroy it. */
+    heap_remove(*ev, *t);
+    free(*t);
+    rearm(*ev);
+}
+
+/**
+ * This function waits for events and calls the functions registered for the
+ * events that occurred. It returns the number of events that were handled.
+ */
+int evloop_run(evloop* ev, int timeout_ms)
+{
+    struct epoll_event ees[EVLOOP_MAX_EVENTS];  /* The events that occured. */
+    struct evloop_handler* h;                   /* The current handler. */
+    int fd;                                     /* The event's fd. */
+    int n;                                      /* Number of events. */
+    int handled;                                /* Number of events handled. */
+    int i;                                      /* Index of current event. */
+
+    /* Wait for events. */
+    if ((n = epoll_wait((*ev)->epfd, ees, EVLOOP_MAX_EVENTS, timeout_ms)) == -1)
+    {
+        /* Being interrupted by a signal is not an error. */
+        if (errno == EINTR)
+            return 0;
+        evloop_err("evloop_run");
+    }
+
+    /* Call the functions registered for the events. An earlier callback may
+     * have removed the fd, or closed it and registered the number again, so
+     * events for a registration that has gone are skipped. */
+    for (i = 0, handled = 0; i < n; i++)
+    {
+        fd = (int) (uint32_t) ees[i].data.u64;
+        h = &(*ev)->handlers[fd];
+        if (h->fn == NULL || h->gen != (uint32_t) (ees[i].data.u64 >> 32))
+            continue;
+        h->fn(ev, fd, ees[i].events, h->arg);
+        handled++;
+    }
+
+    /* Return the number of events that were handled. */
+    return handled;
+}
@@ -0,0 +1,111 @@
+/**
+ * evloop.h
+ *
+ * This file contains the publicly available data-structure and function
+ * prototype declarations for the evloop type.
+ *
+ * The evloop type waits for events on file descriptors with epoll and calls
+ * the functions that were registered for them, so one thread can look after
+ * many sub-processes at once.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#ifndef EVLOOP_H
+#define EVLOOP_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#include "mycutils.h"
+
+/**
+ * This is the evloop data-structure.
+ */
+typedef struct evloop_data* evloop;
+
+/**
+ * This is the type of function that is called when events occur on a file
+ * descriptor. The events are the epoll events that occurred.
+ */
+typedef void (*evloop_fdfn)(evloop* ev, int fd, uint32_t events, void* arg);
+
+/**
+ * This is a timer that belongs to an evloop.
+ */
+typedef struct evloop_timer_data* evloop_timer;
+
+/**
+ * This is the type of function that is called when a timer expires.
+ */
+typedef void (*evloop_timerfn)(evloop* ev, evloop_timer* t, void* arg);
+
+/**
+ * This function initialises the evloop provided to it.
+ */
+void evloop_init(evloop* ev);
+
+/**
+ * This function destroys the evloop provided to it. File descriptors that are
+ * still registered are not closed.
+ */
+void evloop_free(evloop* ev);
+
+/**
+ * This function registers a file descriptor with the evloop. The function
+ * provided is called with arg whenever one of the epoll events provided
+ * occurs on the file descriptor.
+ */
+void evloop_addfd(evloop* ev, int fd, uint32_t events, evloop_fdfn fn,
+                                                       void* arg);
+
+/**
+ * This function changes the epoll events that a registered file descriptor
+ * is being watched for.
+ */
+void evloop_modfd(evloop* ev, int fd, uint32_t events);
+
+/**
+ * This function stops the evloop from watching the file descriptor provided
+ * to it. It is safe to call from within a callback.
+ */
+void evloop_delfd(evloop* ev, int fd);
+
+/**
+ * This function returns the number of file descriptors registered with
+ * the evloop.
+ */
+size_t evloop_nfds(evloop* ev);
+
+/**
+ * This function adds a timer to the evloop. The function provided is called
+ * with arg once delay nanoseconds have passed, and then every interval
+ * nanoseconds if interval is not 0. Every timer shares one timerfd, so idle
+ * timers cost nothing. A timer that does not repeat is destroyed after its
+ * function has returned.
+ */
+evloop_timer evloop_addtimer(evloop* ev, uint64_t delay, uint64_t interval,
+                                         evloop_timerfn fn, void* arg);
+
+/**
+ * This function removes a timer from the evloop and destroys it. It may be
+ * called from within the timer's own function, but not after a timer that
+ * does not repeat has expired.
+ */
+void evloop_deltimer(evloop* ev, evloop_timer* t);
+
+/**
+ * This function waits for up to timeout_ms milliseconds (or forever if it is
+ * -1) for events, and calls the functions registered for the events that
+ * occurred. It returns the number of events that were handled.
+ */
+int evloop_run(evloop* ev, int timeout_ms);
+
+#endif // EVLOOP_H
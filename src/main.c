@@ -2,7 +2,7 @@
  * main.c
  *
  * This file demonstrates the use of the subproc type.
- * 
+ *
  * The subproc type launches a sub-process and uses it to execute a shell
  * command.
  *
@@ -16,6 +16,7 @@
 #include <unistd.h>
 
 #include "mycutils.h"
+#include "evloop.h"
 #include "subproc.h"
 
 /* This is the number of nanoseconds the subproc will run for. */
@@ -25,64 +26,71 @@
  * status messages. */
 #define STATUS_FREQ_TIME NANOS_PER_SEC * (uint64_t) 1
 
+/* Whether the loop should loop. */
+bool running = true;
+
 /**
- * This is the program's main function.
+ * This function is called every STATUS_FREQ_TIME nanoseconds and updates the
+ * user as to the status of the subproc.
  */
-int main (int argc, char* argv[])
+void on_status(evloop* ev, evloop_timer* t, void* arg)
 {
-    subproc sp; /* The sub-process. */
+    /* Print a status message. */
+    fprintf(stdout,
+            "[ %s ] Sub-process is running...\n",
+            timestamp());
+}
+
+/**
+ * This function is called once the subproc has run for SPROC_RUN_TIME
+ * nanoseconds and terminates it.
+ */
+void on_runtime(evloop* ev, evloop_timer* t, void* arg)
+{
+    subproc* sp = (subproc*) arg;   /* The sub-process. */
 
-    /* The time at which the subproc was executed. */
-    struct timespec sp_start;
+    /* Print a status message. */
+    fprintf( stdout,
+            "[ %s ] Sub-process is being terminated...\n",
+            timestamp());
 
-    /* The time at which the subproc's status was last printed to the user. */
-    struct timespec last_status;
+    /* Terminate the subprocess. */
+    subproc_term(sp);
 
-    char* tstamp;   /* A time stamp. */
-    bool running = true;    /* Whether the loop should loop. */
+    /* Stop the loop from looping. */
+    running = false;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main (int argc, char* argv[])
+{
+    subproc sp; /* The sub-process. */
+    evloop ev;  /* Waits for the sub-process and the timers. */
+    char* cmd[] = { "ls", NULL };   /* The command and its arguments. */
 
-    /* Initialise the subprocess and use it to execute a shell command. */
+    /* Initialise the subprocess and use it to execute ls(1) directly. */
+    evloop_init(&ev);
     subproc_init(&sp);
-    subproc_exec(&sp, "ls", "./output/");
-    start_timer(&sp_start);
+    subproc_execv(&sp, cmd, NULL, "./output/");
 
-    /* subproc_exec() will have printed a status message. */
-    start_timer(&last_status);
+    /* Reap the subproc when it exits. */
+    subproc_watch(&sp, &ev, NULL, NULL);
 
-    /* Run the processes. */
+    /* subproc_execv() will have printed a status message, so the next one is
+     * due after STATUS_FREQ_TIME. The subproc is terminated after
+     * SPROC_RUN_TIME. */
+    evloop_addtimer(&ev, STATUS_FREQ_TIME, STATUS_FREQ_TIME, on_status, NULL);
+    evloop_addtimer(&ev, SPROC_RUN_TIME, 0, on_runtime, &sp);
+
+    /* Run the processes. The evloop sleeps until something happens. */
     while (running)
-    {
-        /* Check if the subproc should be terminated. */
-        if (check_timer(sp_start, SPROC_RUN_TIME))
-        {
-            /* Print a status message. */
-            fprintf( stdout,
-                    "[ %s ] Sub-process is being terminated...\n", 
-                    (tstamp = timestamp()));
-
-            /* Terminate the subprocess. */
-            subproc_term( &sp );
-
-            /* Destroy the subproc. */
-            subproc_free( &sp );
-
-            /* Stop the loop from looping. */
-            running = false;
-        }
-
-        /* Check if the user should be updated as to the status of
-         * the subproc. */
-        else if (check_timer(last_status, STATUS_FREQ_TIME))
-        {
-            /* Print a status message. */
-            fprintf(stdout, 
-                    "[ %s ] Sub-process is running...\n",
-                    (tstamp = timestamp()));
- 
-            /* Reset the timer. */
-            start_timer(&last_status); 
-        }
-    }
+        evloop_run(&ev, -1);
+
+    /* Destroy the subproc and the evloop. */
+    subproc_free(&sp);
+    evloop_free(&ev);
 
     /* Exit the program. */
     exit(EXIT_SUCCESS);
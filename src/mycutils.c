@@ -7,6 +7,8 @@
  * Author: Richard Gale
  */
 
+#define _GNU_SOURCE
+
 #include "mycutils.h"
 
 /******************************** Maths **************************************/
@@ -28,45 +30,25 @@ double map(double x, double in_min,  double in_max,
  */
 bool check_timer(struct timespec start, uint64_t wait_time)
 {
-    const bool HAS_ELAPSED = true;      /* Value if time has elapsed. */
-    const bool NOT_ELAPSED = false;     /* Value if time has not elapsed. */
-    struct timespec current;            /* The current time. */
-    struct timespec elapsed;            /* The time elapsed since start. */
-
-    /* Obtaining the current time. */
-    clock_gettime(CLOCK_REALTIME, &current);
-
-    /* Calculating the elapsed time. */
-    elapsed.tv_sec = current.tv_sec - start.tv_sec;
-    elapsed.tv_nsec = current.tv_nsec - start.tv_nsec;
-
-    /* Checking whether the time hasn't elapsed. */
-    if ((elapsed.tv_sec * NANOS_PER_SEC) + elapsed.tv_nsec < wait_time)
-        return NOT_ELAPSED;
-
-    /* The time has elapsed. */
-    return HAS_ELAPSED;
+    /* Checking whether the deadline has passed. */
+    return deadline_passed((uint64_t) start.tv_sec * NANOS_PER_SEC
+                           + start.tv_nsec + wait_time);
 }
 
 /**
- * This function obtains the current time and stores it in the timespec
- * that was provided to it.
+ * This function obtains the current time on the monotonic clock and stores
+ * it in the timespec that was provided to it.
  */
 void start_timer(struct timespec* ts)
 {
-    char* tstamp;
-
     /* Obtaining the current time.*/
-    if ((clock_gettime(CLOCK_REALTIME, ts)) != -1)
+    if ((clock_gettime(CLOCK_MONOTONIC, ts)) != -1)
         return;
         
     /* An error occured so we are printing an error message. */
     fprintf(stderr, 
             "[ %s ] ERROR: in function start_timer(): %s\n",
-            (tstamp = timestamp()), strerror(errno));
-
-    /* De-allocating memory. */
-    free(tstamp);
+            timestamp(), strerror(errno));
 
     /* Exiting the program. */
     exit(EXIT_FAILURE);
@@ -74,29 +56,101 @@ void start_timer(struct timespec* ts)
 }
 
 /**
- * This function returns a string that represent the current time.
- * For reasons detailed in a comment within this function, you must
- * free() the string that this function returns.
+ * This function creates a timerfd on the monotonic clock and returns its file
+ * descriptor. If there is an error it is printed on stderr and the program
+ * exits.
  */
-char* timestamp()
+int mktimer()
 {
-    time_t current_time;    /* The current time. */
-    char* stamp;            /* The time stamp. */
-    char* stamp_cpy;        /* A Copy of the time stamp. */
+    int fd;         /* The timerfd. */
 
-    /* Obtaining the current time. */
-    if ((current_time = time(NULL)) == ((time_t) - 1))
-    {
-        /* An error occured so we're printing an error message to and exiting
-         * the program. */
-        fprintf(stderr, 
-                "ERROR: In function timestamp(): "
-                "Calender time is not available\n");
-        exit(EXIT_FAILURE);
-    }
+    /* Creating the timer. */
+    if ((fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))
+        != -1)
+        return fd;
+
+    /* An error occured so we are printing an error message. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In function mktimer(): %s\n",
+            timestamp(), strerror(errno));
+
+    /* Exiting the program. */
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * This function arms the timerfd provided to it to expire when mono_now()
+ * reaches deadline, and then every interval nanoseconds if interval is not 0.
+ * A deadline of 0 disarms the timer.
+ */
+void settimer(int fd, uint64_t deadline, uint64_t interval)
+{
+    struct itimerspec its;  /* When the timer expires. */
+
+    /* Converting the times to timespecs. */
+    its.it_value.tv_sec = deadline / NANOS_PER_SEC;
+    its.it_value.tv_nsec = deadline % NANOS_PER_SEC;
+    its.it_interval.tv_sec = interval / NANOS_PER_SEC;
+    its.it_interval.tv_nsec = interval % NANOS_PER_SEC;
+
+    /* Arming the timer. */
+    timerfd_settime(fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * This function returns the number of times the timerfd provided to it has
+ * expired since it was last acknowledged, or 0 if it has not expired.
+ */
+uint64_t acktimer(int fd)
+{
+    uint64_t n;     /* The number of expirations. */
+
+    /* Reading the number of expirations. */
+    if (read(fd, &n, sizeof(n)) != sizeof(n))
+        return 0;
+
+    return n;
+}
+
+/**
+ * This is the size of the cached time stamps. It holds the longest date and
+ * year strftime() can leave in the cache's buffers, joined with a millisecond
+ * field as wide as any long, so the stamps are never cut short.
+ */
+#define TSCACHE_LEN (TIMESTAMP_LEN + 8 + 24)
+
+/**
+ * This is the timestamp cache of a thread. The strings are only reformatted
+ * when the second (or millisecond) they show has passed.
+ */
+struct tscache {
+    time_t sec;                     /* The second that is cached. */
+    long ms;                        /* The millisecond that is cached. */
+    char date[TIMESTAMP_LEN];       /* The time up to the seconds. */
+    char year[8];                   /* The year, after a space. */
+    char stamp[TSCACHE_LEN];        /* The time to the second. */
+    char stamp_ms[TSCACHE_LEN];     /* The time to the millisecond. */
+};
+
+/**
+ * Each thread has its own cache so no locking is needed.
+ */
+static __thread struct tscache tscache = { -1, -1 };
+
+/**
+ * This function brings the timestamp cache up to date with the time provided
+ * to it.
+ */
+void tscache_update(struct timespec* ts)
+{
+    struct tm tm;   /* The time broken down into local time. */
+
+    /* The cache is still current. */
+    if (ts->tv_sec == tscache.sec)
+        return;
 
     /* Converting time to local time format. */
-    if ((stamp = ctime(&current_time)) == NULL)
+    if (localtime_r(&ts->tv_sec, &tm) == NULL)
     {
         /* An error occured converting so we're printing an error message
          * and exiting the program. */
@@ -106,22 +160,67 @@ char* timestamp()
         exit(EXIT_FAILURE);
     }
 
-    /* The string that ctime() returns is not one that should be be freed
-     * with free() because the memory it uses was not allocated with malloc()
-     * or a similar function. Because we are going to use sdelchar() to remove
-     * the newline character that ctime() added to our timestamp, and
-     * sdelchar() uses free() to remove chars from strings, we have to make
-     * a copy of our stamp.
-     * If this copy is not freed by the calling function, it will create a 
-     * memory leak.
-     */
-    strfmt(&stamp_cpy, "%s", stamp);
+    /* Formatting the time the same way as ctime(), without the newline. */
+    strftime(tscache.date, sizeof(tscache.date), "%a %b %e %H:%M:%S", &tm);
+    strftime(tscache.year, sizeof(tscache.year), " %Y", &tm);
+    snprintf(tscache.stamp, sizeof(tscache.stamp), "%s%s",
+             tscache.date, tscache.year);
+    tscache.sec = ts->tv_sec;
+    tscache.ms = -1;
+}
 
-    /* Removing the newline character that was added by ctime(). */
-    sdelchar(&stamp_cpy, '\n');
+/**
+ * This function returns a string that represent the current time. The string
+ * belongs to the calling thread and is only reformatted once per second; it
+ * must not be freed and is overwritten by the thread's next call.
+ */
+const char* timestamp()
+{
+    struct timespec ts;     /* The current time. */
 
-    /* Returning the copy of the time stamp. */
-    return stamp_cpy;
+    /* Obtaining the current time. The coarse clock is enough to the second
+     * and is cheaper to read. */
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+
+    /* Returning the cached time stamp. */
+    tscache_update(&ts);
+    return tscache.stamp;
+}
+
+/**
+ * This function returns a string that represent the current time to the
+ * millisecond. The string is cached in the same way as timestamp().
+ */
+const char* timestamp_ms()
+{
+    struct timespec ts;     /* The current time. */
+    long ms;                /* The current millisecond. */
+
+    /* Obtaining the current time. */
+    clock_gettime(CLOCK_REALTIME, &ts);
+    tscache_update(&ts);
+
+    /* Adding the milliseconds if they have changed. */
+    if ((ms = ts.tv_nsec / 1000000) != tscache.ms)
+    {
+        snprintf(tscache.stamp_ms, sizeof(tscache.stamp_ms), "%s.%03ld%s",
+                 tscache.date, ms, tscache.year);
+        tscache.ms = ms;
+    }
+
+    return tscache.stamp_ms;
+}
+
+/**
+ * This function copies a string that represent the current time into the
+ * buffer provided to it, which should hold TIMESTAMP_LEN chars, and returns
+ * the buffer.
+ */
+char* timestamp_r(char* buf, size_t size)
+{
+    /* Copying the cached time stamp. */
+    snprintf(buf, size, "%s", timestamp());
+    return buf;
 }
 
 /******************************** In/Out *************************************/
@@ -156,6 +255,7 @@ void scans(char** buf, char* prompt)
         move_cursor(strlen(prompt) + strlen(*buf), AFTER);
 
         /* Getting and processing user input. */
+        term_flush();
         switch (userin = scanc_nowait())
         {
             /* Backspace. */
@@ -218,8 +318,6 @@ char scanc_nowait() {
  */
 void closefs(FILE* fs)
 {
-    char* tstamp;   /* A time stamp. */
-
     /* Closing the file stream. */
     if (fclose(fs) == 0)
         return;
@@ -227,10 +325,7 @@ void closefs(FILE* fs)
     /* An error occured so we are printing an error message. */
     fprintf(stderr,
             "[ %s ] ERROR: In function closefs: %s\n", 
-            (tstamp = timestamp()), strerror(errno));
-
-    /* De-allocating memory. */
-    free(tstamp);
+            timestamp(), strerror(errno));
 
     /* Exiting the program. */
     exit(EXIT_FAILURE);
@@ -246,7 +341,6 @@ void closefs(FILE* fs)
 FILE* openfs(char* fname, char* mode)
 {
     FILE* fs;       /* The pointer to the file stream. */
-    char* tstamp;   /* A time stamp. */
 
     /* Opening the file. */
     if ((fs = fopen(fname, mode)) != NULL)
@@ -256,15 +350,66 @@ FILE* openfs(char* fname, char* mode)
     fprintf(stderr, 
             "[ %s ] ERROR: In function openfs(): "
             "Could not open file %s: %s\n",
-            (tstamp = timestamp()), fname, strerror(errno));
-
-    /* De-allocating memory. */
-    free(tstamp);
+            timestamp(), fname, strerror(errno));
 
     /* Freeing memory. */
     exit(EXIT_FAILURE);
 }
 
+/**
+ * This function closes the file descriptor provided to it. If there is an
+ * error, it is printed on stderr and the program will exit.
+ */
+void closefd(int fd)
+{
+    /* Closing the file descriptor. */
+    if (close(fd) == 0)
+        return;
+
+    /* An error occured so we are printing an error message. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In function closefd: %s\n",
+            timestamp(), strerror(errno));
+
+    /* Exiting the program. */
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * This function opens a file that has a name that matches fname with open(),
+ * using the flags and permission mode provided to it.
+ * If there is an error it will be printed on stderr and the program
+ * is exited. If the file is successfully opened, this function
+ * will return its file descriptor.
+ */
+int openfd(char* fname, int flags, mode_t mode)
+{
+    /* Opening the file relative to the working directory. */
+    return openfdat(AT_FDCWD, fname, flags, mode);
+}
+
+/**
+ * This function is the same as openfd() but opens fname relative to the
+ * directory referred to by dirfd.
+ */
+int openfdat(int dirfd, char* fname, int flags, mode_t mode)
+{
+    int fd;         /* The file descriptor. */
+
+    /* Opening the file. */
+    if ((fd = openat(dirfd, fname, flags, mode)) != -1)
+        return fd;
+
+    /* An error occured so we're printing an error message. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In function openfdat(): "
+            "Could not open file %s: %s\n",
+            timestamp(), fname, strerror(errno));
+
+    /* Exiting the program. */
+    exit(EXIT_FAILURE);
+}
+
 /**
  * This function assigns the next char in the file stream provided to it to
  * the buffer provided to it. It returns true on success or false if EOF is
@@ -274,7 +419,6 @@ bool readfsc(FILE* fs, char* buf)
 {
     const bool SUCCESS = true;      /* Return value if success. */
     const bool END_OF_FILE = false; /* Return value if EOF. */
-    char* tstamp;
 
     /* Getting the next char from the file stream and checking if it was
      * successfully read. */
@@ -288,10 +432,7 @@ bool readfsc(FILE* fs, char* buf)
     /* An error occurred so we're printing an error message. */
     fprintf(stderr,
             "[ %s ] ERROR: In function readfsc(): %s\n",
-            (tstamp = timestamp()), strerror(errno));
-
-    /* De-allocating memory. */
-    free(tstamp);
+            timestamp(), strerror(errno));
 
     /* Exiting the program. */
     exit(EXIT_FAILURE);
@@ -309,7 +450,6 @@ bool readfsl(FILE* fs, char** buf)
     const bool SUCCESS = true;      /* Return value if success. */
     const bool END_OF_FILE = false; /* Return value if EOF. */
     size_t n;                       /* Allocated size of the buffer. */
-    char* tstamp;                   /* A time stamp. */
 
     /* Initialising how big the buffer is. */
     n = 0;
@@ -328,13 +468,144 @@ bool readfsl(FILE* fs, char** buf)
             "[ %s ] ERROR: In function readfsl: %s\n",
             timestamp(), strerror(errno));
 
-    /* De-allocating memory. */
-    free(tstamp);
+    /* Exiting the program. */
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * This function initialises the line reader provided to it to read the file
+ * stream provided to it.
+ */
+void linereader_init(linereader* lr, FILE* fs)
+{
+    lr->fs = fs;
+    lr->line = NULL;
+    lr->len = 0;
+    lr->size = 0;
+}
+
+/**
+ * This function frees the buffer of the line reader provided to it.
+ */
+void linereader_free(linereader* lr)
+{
+    free(lr->line);
+    lr->line = NULL;
+    lr->len = 0;
+    lr->size = 0;
+}
+
+/**
+ * This function reads the next line into the line reader provided to it. It
+ * returns true if a line was read or false if EOF was reached.
+ */
+bool linereader_next(linereader* lr)
+{
+    ssize_t len;    /* The length of the line. */
+
+    /* Reading the next line into the buffer, which getline() only grows. */
+    if ((len = getline(&lr->line, &lr->size, lr->fs)) != -1)
+    {
+        lr->len = (size_t) len;
+        return true;
+    }
+    lr->len = 0;
+
+    /* Checking if EOF was reached. */
+    if (!ferror(lr->fs))
+        return false;
+
+    /* An error occurred so we are printing an error message. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In function linereader_next(): %s\n",
+            timestamp(), strerror(errno));
 
     /* Exiting the program. */
     exit(EXIT_FAILURE);
 }
 
+/**
+ * This function maps the file that has a name that matches fname into the
+ * scanner provided to it.
+ */
+void fscan_open(fscan* sc, char* fname)
+{
+    struct stat st; /* The file's status. */
+    int fd;         /* The file descriptor. */
+
+    /* Opening the file and finding its size. */
+    fd = openfd(fname, O_RDONLY | O_CLOEXEC, 0);
+    if (fstat(fd, &st) == -1)
+    {
+        fprintf(stderr,
+                "[ %s ] ERROR: In function fscan_open(): %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    sc->size = (size_t) st.st_size;
+    sc->pos = 0;
+    sc->data = NULL;
+
+    /* Mapping the file, which stays mapped once its descriptor is closed.
+     * An empty file cannot be mapped and has no lines. */
+    if (sc->size > 0)
+    {
+        sc->data = (char*) mmap(NULL, sc->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (sc->data == MAP_FAILED)
+        {
+            fprintf(stderr,
+                    "[ %s ] ERROR: In function fscan_open(): "
+                    "Could not map file %s: %s\n",
+                    timestamp(), fname, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        /* The file is read from start to end. */
+        madvise(sc->data, sc->size, MADV_SEQUENTIAL);
+    }
+    closefd(fd);
+}
+
+/**
+ * This function unmaps the file of the scanner provided to it.
+ */
+void fscan_close(fscan* sc)
+{
+    if (sc->data != NULL)
+        munmap(sc->data, sc->size);
+    sc->data = NULL;
+    sc->size = 0;
+    sc->pos = 0;
+}
+
+/**
+ * This function points the view provided to it at the next line of the
+ * scanner provided to it, without its newline.
+ */
+bool fscan_next(fscan* sc, strview* line)
+{
+    char* nl;   /* The newline at the end of the line. */
+
+    /* Checking if the end of the file was reached. */
+    if (sc->pos >= sc->size)
+        return false;
+
+    /* Finding the end of the line. The last line may have no newline. */
+    line->ptr = sc->data + sc->pos;
+    if ((nl = memchr(line->ptr, '\n', sc->size - sc->pos)) != NULL)
+    {
+        line->len = (size_t) (nl - line->ptr);
+        sc->pos += line->len + 1;
+    }
+    else
+    {
+        line->len = sc->size - sc->pos;
+        sc->pos = sc->size;
+    }
+
+    return true;
+}
+
 /**
  * This function writes the char provided to it to the file stream provided to
  * it.
@@ -342,7 +613,7 @@ bool readfsl(FILE* fs, char** buf)
 void writefsc(FILE* fs, char ch)
 {
     /* Writing the char to the file stream. */
-    fprintf(fs, "%c", ch); 
+    fputc(ch, fs);
 }
 
 /**
@@ -351,11 +622,378 @@ void writefsc(FILE* fs, char ch)
  */
 void writefss(FILE* fs, char* str)
 {
-    int c;  /* Index of the current char in the string. */
+    /* Writing the string to the file stream in one go. */
+    writefsn(fs, str, strlen(str));
+}
+
+/**
+ * This function writes n bytes from the buffer provided to it to the file
+ * stream provided to it.
+ */
+void writefsn(FILE* fs, const void* buf, size_t n)
+{
+    /* Writing the bytes to the file stream. */
+    if (fwrite(buf, 1, n, fs) == n)
+        return;
 
-    /* Writing the string to the file stream. */
-    for (c = 0; c < strlen(str); c++)
-        writefsc(fs, str[c]);
+    /* An error occured so we are printing an error message. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In function writefsn(): %s\n",
+            timestamp(), strerror(errno));
+
+    /* Exiting the program. */
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * This function waits until the file descriptor provided to it can be written
+ * to without blocking.
+ */
+void waitwritable(int fd)
+{
+    struct pollfd pfd;  /* What to wait for. */
+
+    pfd.fd = fd;
+    pfd.events = POLLOUT;
+    while (poll(&pfd, 1, -1) == -1 && errno == EINTR);
+}
+
+/**
+ * This function writes n bytes from the buffer provided to it to the file
+ * descriptor provided to it.
+ */
+void writefd(int fd, const void* buf, size_t n)
+{
+    ssize_t done;   /* The number of bytes written by write(). */
+
+    /* Writing until every byte is out. */
+    while (n > 0)
+    {
+        if ((done = write(fd, buf, n)) == -1)
+        {
+            /* Being interrupted by a signal is not an error. */
+            if (errno == EINTR)
+                continue;
+
+            /* Neither is a non-blocking file descriptor being full. */
+            if (errno == EAGAIN)
+            {
+                waitwritable(fd);
+                continue;
+            }
+
+            /* An error occured so we are printing an error message. */
+            fprintf(stderr,
+                    "[ %s ] ERROR: In function writefd(): %s\n",
+                    timestamp(), strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        buf = (const char*) buf + done;
+        n -= (size_t) done;
+    }
+}
+
+/**
+ * This is the largest number of iovecs writev() takes at once on Linux.
+ */
+#define WRITEV_MAX 1024
+
+/**
+ * This function writes the cnt buffers described by iov to the file descriptor
+ * provided to it.
+ */
+void writefdv(int fd, struct iovec* iov, int cnt)
+{
+    ssize_t done;   /* The number of bytes written by writev(). */
+    int max;        /* The number of iovecs writev() takes at once. */
+
+    /* Skipping empty buffers at the start. */
+    for (; cnt > 0 && iov->iov_len == 0; iov++, cnt--);
+
+    while (cnt > 0)
+    {
+        /* Writing as many of the buffers as writev() takes. */
+        max = (cnt < WRITEV_MAX) ? cnt : WRITEV_MAX;
+        if ((done = writev(fd, iov, max)) == -1)
+        {
+            /* Being interrupted by a signal is not an error. */
+            if (errno == EINTR)
+                continue;
+
+            /* Neither is a non-blocking file descriptor being full. */
+            if (errno == EAGAIN)
+            {
+                waitwritable(fd);
+                continue;
+            }
+
+            /* An error occured so we are printing an error message. */
+            fprintf(stderr,
+                    "[ %s ] ERROR: In function writefdv(): %s\n",
+                    timestamp(), strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+
+        /* Using up the buffers that were written, and the part of the one
+         * that was written short. */
+        for (; cnt > 0 && (size_t) done >= iov->iov_len; iov++, cnt--)
+            done -= (ssize_t) iov->iov_len;
+        if (cnt > 0)
+        {
+            iov->iov_base = (char*) iov->iov_base + done;
+            iov->iov_len -= (size_t) done;
+        }
+    }
+}
+
+/**
+ * This function initialises the output buffer provided to it to write to fd.
+ */
+void outbuf_init(outbuf* ob, int fd, char* buf, size_t size)
+{
+    ob->fd = fd;
+    ob->len = 0;
+
+    /* Using the buffer provided, or allocating one. */
+    if ((ob->heap = (buf == NULL)))
+    {
+        ob->size = (size > 0) ? size : OUTBUF_LEN;
+        if ((ob->buf = (char*) malloc(ob->size)) == NULL)
+        {
+            fprintf(stderr,
+                    "[ %s ] ERROR: In function outbuf_init(): %s\n",
+                    timestamp(), strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
+    {
+        ob->buf = buf;
+        ob->size = size;
+    }
+}
+
+/**
+ * This function flushes the output buffer provided to it and frees the memory
+ * it allocated.
+ */
+void outbuf_free(outbuf* ob)
+{
+    outbuf_flush(ob);
+    if (ob->heap)
+        free(ob->buf);
+    ob->buf = NULL;
+    ob->size = 0;
+}
+
+/**
+ * This function appends n bytes from the buffer provided to it to the output
+ * buffer provided to it.
+ */
+void outbuf_write(outbuf* ob, const void* data, size_t n)
+{
+    struct iovec iov[2];    /* What is buffered and the new bytes. */
+
+    /* Buffering the bytes if they fit. */
+    if (n <= ob->size - ob->len)
+    {
+        memcpy(ob->buf + ob->len, data, n);
+        ob->len += n;
+        return;
+    }
+
+    /* Bytes that would not fit in an empty buffer either are sent straight
+     * away along with what is buffered. */
+    if (n >= ob->size)
+    {
+        iov[0].iov_base = ob->buf;
+        iov[0].iov_len = ob->len;
+        iov[1].iov_base = (void*) data;
+        iov[1].iov_len = n;
+        writefdv(ob->fd, iov, 2);
+        ob->len = 0;
+        return;
+    }
+
+    /* Otherwise the buffer is sent to make room. */
+    outbuf_flush(ob);
+    memcpy(ob->buf, data, n);
+    ob->len = n;
+}
+
+/**
+ * This function appends the cnt buffers described by iov to the output buffer
+ * provided to it.
+ */
+void outbuf_writev(outbuf* ob, const struct iovec* iov, int cnt)
+{
+    int i;  /* Index of the current buffer. */
+
+    for (i = 0; i < cnt; i++)
+        outbuf_write(ob, iov[i].iov_base, iov[i].iov_len);
+}
+
+/**
+ * This function sends everything in the output buffer provided to it.
+ */
+void outbuf_flush(outbuf* ob)
+{
+    writefd(ob->fd, ob->buf, ob->len);
+    ob->len = 0;
+}
+
+/******************************** Memory *************************************/
+
+/**
+ * This is the alignment of the allocations made from an arena.
+ */
+#define ARENA_ALIGN 16
+
+/**
+ * This is an extra block of an arena, allocated when it ran out of room.
+ */
+struct arena_extra {
+    struct arena_extra* next;   /* The next extra block. */
+    max_align_t data[];         /* The memory handed out. */
+};
+
+/**
+ * This function initialises the arena provided to it with a block of size
+ * bytes. If there is an error it is printed on stderr and the program exits.
+ */
+void arena_init(arena* a, size_t size)
+{
+    /* Allocating the block. */
+    if ((a->base = (char*) malloc(size)) == NULL)
+    {
+        /* An error occured so we are printing an error message and exiting
+         * the program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In function arena_init(): %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* The arena is empty. */
+    a->size = size;
+    a->used = 0;
+    a->extra = NULL;
+    a->spilled = 0;
+}
+
+/**
+ * This function frees the memory of the arena provided to it.
+ */
+void arena_free(arena* a)
+{
+    /* Freeing the extra blocks, then the block. */
+    arena_reset(a);
+    free(a->base);
+    a->base = NULL;
+    a->size = 0;
+}
+
+/**
+ * This function returns n bytes from the arena provided to it, aligned for
+ * any type.
+ */
+void* arena_alloc(arena* a, size_t n)
+{
+    struct arena_extra* x;  /* An extra block. */
+    size_t start;           /* Where the allocation starts in the block. */
+
+    /* Taking the bytes from the block if there is room. */
+    start = (a->used + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    if (start + n <= a->size)
+    {
+        a->used = start + n;
+        return a->base + start;
+    }
+
+    /* Otherwise allocating an extra block for them. */
+    if ((x = (struct arena_extra*) malloc(sizeof(struct arena_extra) + n))
+        == NULL)
+    {
+        /* An error occured so we are printing an error message and exiting
+         * the program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In function arena_alloc(): %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    x->next = (struct arena_extra*) a->extra;
+    a->extra = x;
+    a->spilled += n + ARENA_ALIGN;
+    return x->data;
+}
+
+/**
+ * This function empties the arena provided to it.
+ */
+void arena_reset(arena* a)
+{
+    struct arena_extra* x;  /* The current extra block. */
+
+    /* Freeing the extra blocks. */
+    while ((x = (struct arena_extra*) a->extra) != NULL)
+    {
+        a->extra = x->next;
+        free(x);
+    }
+
+    /* Growing the block so that what spilled over fits next time. */
+    if (a->spilled > 0)
+    {
+        free(a->base);
+        arena_init(a, a->size + a->spilled);
+    }
+
+    /* Emptying the block. */
+    a->used = 0;
+}
+
+/**
+ * This function is the same as astrfmt() but takes a variable argument list.
+ */
+char* vastrfmt(arena* a, char* fmt, va_list lp)
+{
+    va_list lp_cpy;     /* A copy of the list of arguments. */
+    size_t start;       /* Where the string would start in the block. */
+    size_t room;        /* The room left in the block. */
+    int len;            /* The length of the string. */
+    char* str;          /* The string. */
+
+    /* Formatting straight into the rest of the block, which is enough
+     * almost every time. */
+    start = (a->used + ARENA_ALIGN - 1) & ~((size_t) ARENA_ALIGN - 1);
+    room = (start < a->size) ? a->size - start : 0;
+    va_copy(lp_cpy, lp);
+    len = vsnprintf((room > 0) ? a->base + start : NULL, room, fmt, lp_cpy);
+    va_end(lp_cpy);
+    if ((size_t) len < room)
+        return (char*) arena_alloc(a, len + 1);
+
+    /* Otherwise formatting again into an allocation of the right size. */
+    str = (char*) arena_alloc(a, len + 1);
+    vsnprintf(str, len + 1, fmt, lp);
+    return str;
+}
+
+/**
+ * This function formats a string in the same way as strfmt(), but takes the
+ * memory for it from the arena provided to it and returns the string.
+ */
+char* astrfmt(arena* a, char* fmt, ...)
+{
+    va_list lp;     /* Pointer to the list of arguments. */
+    char* str;      /* The string. */
+
+    /* Formatting the string. */
+    va_start(lp, fmt);
+    str = vastrfmt(a, fmt, lp);
+    va_end(lp);
+
+    return str;
 }
 
 /******************************** Strings ************************************/
@@ -387,94 +1025,299 @@ size_t vbytesfmt(va_list lp, char* fmt)
 /**
  * This function dynamically allocates only the needed amount of memory to a
  * string based on the argument list, then concatenates the argument list into 
- * the supplied format and stores it in the supplied string pointer.
+ * the supplied format and stores it in the supplied string pointer. Short
+ * strings are formatted once, on the stack, and then copied.
  */
 void strfmt(char** sp, char *fmt, ...)
 {
-    va_list lp;     /* Pointer to the list of arguments. */
-    size_t bytes;   /* The number of bytes the string needs. */
+    va_list lp;                 /* Pointer to the list of arguments. */
+    va_list lp_cpy;             /* A Copy of the list of arguments. */
+    char buf[STRFMT_STACK_LEN]; /* Space to format short strings in. */
+    int len;                    /* The length of the string. */
 
     /* Pointing to the first argument. */
     va_start(lp, fmt);
 
-    /* Getting the number of bytes the string will need to be allocated. */
-    bytes = vbytesfmt(lp, fmt);
+    /* Formatting the string on the stack, which also finds its length. */
+    va_copy(lp_cpy, lp);
+    len = vsnprintf(buf, sizeof(buf), fmt, lp_cpy);
+    va_end(lp_cpy);
 
     /* Allocating memory to the string. */
-    *sp = (char*) malloc(bytes);
+    *sp = (char*) malloc(len + 1);
 
-    /* Creating the string. */
-    vsprintf(*sp, fmt, lp);
+    /* Copying the string if it fitted, or creating it again if it did
+     * not. */
+    if ((size_t) len < sizeof(buf))
+        memcpy(*sp, buf, len + 1);
+    else
+        vsnprintf(*sp, len + 1, fmt, lp);
 
     /* Assuring a clean finish to the argument list. */
     va_end(lp);
 }
 
 /**
- * This function removes the char element from the string provided to it which
- * is at the element number/index provided to it.
+ * This function initialises the string builder provided to it. The builder
+ * starts out using the buffer provided, which may be on the stack, and only
+ * moves to the heap if the string outgrows it. buf may be NULL.
  */
-void sdelelem(char** sp, unsigned elem)
+void strbuf_init(strbuf* sb, char* buf, size_t size)
+{
+    /* Starting with an empty string in the buffer. */
+    sb->str = (buf != NULL && size > 0) ? buf : NULL;
+    sb->size = (sb->str != NULL) ? size : 0;
+    sb->len = 0;
+    sb->heap = false;
+    if (sb->str != NULL)
+        sb->str[0] = '\0';
+}
+
+/**
+ * This function frees the memory that the string builder provided to it
+ * allocated.
+ */
+void strbuf_free(strbuf* sb)
+{
+    /* Freeing the string if it is on the heap. */
+    if (sb->heap)
+        free(sb->str);
+    sb->str = NULL;
+    sb->size = 0;
+    sb->len = 0;
+    sb->heap = false;
+}
+
+/**
+ * This function empties the string builder provided to it, keeping its
+ * memory.
+ */
+void strbuf_reset(strbuf* sb)
+{
+    sb->len = 0;
+    if (sb->str != NULL)
+        sb->str[0] = '\0';
+}
+
+/**
+ * This function makes sure the string builder provided to it has room for n
+ * more chars and the null character.
+ */
+void strbuf_reserve(strbuf* sb, size_t n)
 {
-    char* to_elem;      /* Chars from start of string to element to delete. */
-    char* from_elem;    /* Chars from element to delete to end of string. */
-    unsigned c;         /* The current char in the string. */
+    size_t size;    /* The new size of the string. */
+    char* str;      /* The new string. */
 
-    /* Allocating memory. */
-    to_elem     = (char*) malloc(sizeof(char) * (elem + 1));
-    from_elem   = (char*) malloc(sizeof(char) * (strlen(*sp) - elem));
+    /* Checking whether there is already room. */
+    if (sb->len + n < sb->size)
+        return;
+
+    /* Growing to at least double the size. */
+    for (size = (sb->size > 0) ? sb->size * 2 : 64; size <= sb->len + n;
+         size *= 2);
 
-    /* Storing the two sections of the string. */
-    for (c = 0; c < strlen(*sp); c++)
+    if (sb->heap)
+        str = (char*) realloc(sb->str, size);
+    else if ((str = (char*) malloc(size)) != NULL)
     {
-        if (c < elem)
-            to_elem[c] = (*sp)[c];
-        if (c > elem)
-            from_elem[c] = (*sp)[c];
+        /* Moving the string off the caller's buffer. */
+        memcpy(str, (sb->str != NULL) ? sb->str : "", sb->len + 1);
     }
-    to_elem[elem] = '\0';
-    from_elem[strlen(*sp) - elem - 1] = '\0';
+    if (str == NULL)
+    {
+        /* An error occured so we are printing an error message and exiting
+         * the program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In function strbuf_reserve(): %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    sb->str = str;
+    sb->size = size;
+    sb->heap = true;
+}
 
-    /* Recreating the string. */
-    free(*sp);
-    strfmt(sp, "%s%s", to_elem, from_elem);
+/**
+ * This function appends n chars from the string provided to it to the
+ * string builder provided to it.
+ */
+void strbuf_cat(strbuf* sb, const char* str, size_t n)
+{
+    /* Appending the chars. */
+    strbuf_reserve(sb, n);
+    memcpy(sb->str + sb->len, str, n);
+    sb->len += n;
+    sb->str[sb->len] = '\0';
+}
 
-    /* Cleaning up. */
-    free(to_elem);
-    free(from_elem);
+/**
+ * This function is the same as strbuf_fmt() but takes a variable argument
+ * list.
+ */
+void strbuf_vfmt(strbuf* sb, char* fmt, va_list lp)
+{
+    va_list lp_cpy;     /* A copy of the list of arguments. */
+    size_t room;        /* The room left in the string. */
+    int len;            /* The length of the formatted text. */
+
+    /* Formatting straight onto the end of the string. */
+    room = sb->size - sb->len;
+    va_copy(lp_cpy, lp);
+    len = vsnprintf((room > 0) ? sb->str + sb->len : NULL, room, fmt, lp_cpy);
+    va_end(lp_cpy);
+
+    /* Making room and formatting again only if it did not fit. */
+    if ((size_t) len >= room)
+    {
+        strbuf_reserve(sb, len);
+        vsnprintf(sb->str + sb->len, len + 1, fmt, lp);
+    }
+    sb->len += len;
+}
+
+/**
+ * This function appends text to the string builder provided to it, formatted
+ * from the format string and argument list.
+ */
+void strbuf_fmt(strbuf* sb, char* fmt, ...)
+{
+    va_list lp;     /* Pointer to the list of arguments. */
+
+    /* Appending the formatted text. */
+    va_start(lp, fmt);
+    strbuf_vfmt(sb, fmt, lp);
+    va_end(lp);
+}
+
+/**
+ * This function removes the char element from the string provided to it which
+ * is at the element number/index provided to it. The string is edited in
+ * place.
+ */
+void sdelelem(char** sp, unsigned elem)
+{
+    size_t len;     /* The length of the string. */
+
+    /* Ignoring elements past the end of the string. */
+    if (elem >= (len = strlen(*sp)))
+        return;
+
+    /* Moving the rest of the string, including the null character, over
+     * the element. */
+    memmove(*sp + elem, *sp + elem + 1, len - elem);
 }
 
 /**
  * This function removes all cases of the provided char from the string at the
- * provided pointer.
+ * provided pointer. The string is edited in place.
  */
 void sdelchar(char** sp, char remove)
 {
-    unsigned c;     /* Index of current char in the string. */
+    char set[2];    /* The char to remove as a set. */
 
-    /* Overwriting the unwanted characters. */
-	for (c = 0; c < strlen(*sp); c++)
-	{
-        if ((*sp)[c] == remove)
-        {
-            sdelelem(sp, c);
+    /* Removing the char. */
+    set[0] = remove;
+    set[1] = '\0';
+    sdelchars(*sp, set);
+}
 
-            /* Decrementing the index so we will check the replacement 
-             * character. */
-            c--;
-        }
+/**
+ * This function removes every char that is in the set provided to it from the
+ * string provided to it, in place and in a single pass, and returns the new
+ * length of the string. Runs of chars to keep are found with strcspn() (or
+ * strchrnul() for a single char), which glibc implements with SSE2/AVX2
+ * where the CPU has them, and are moved down as whole blocks.
+ */
+size_t sdelchars(char* str, char* set)
+{
+    char* src;      /* The next char to look at. */
+    char* dst;      /* Where the next kept char goes. */
+    size_t run;     /* The length of the current run of kept chars. */
+
+    for (src = dst = str; ; src++)
+    {
+        /* Finding the end of the run of chars to keep. */
+        if (set[0] != '\0' && set[1] == '\0')
+            run = strchrnul(src, set[0]) - src;
+        else
+            run = strcspn(src, set);
+
+        /* Moving the run down over the removed chars. */
+        if (dst != src)
+            memmove(dst, src, run);
+        dst += run;
+        src += run;
+
+        /* Stopping at the end of the string. */
+        if (*src == '\0')
+            break;
     }
+    *dst = '\0';
+
+    /* Returning the new length. */
+    return dst - str;
 }
 
 /******************************* Terminal ************************************/
 
+/**
+ * Whether the terminal understands ANSI escape sequences: -1 until it has been
+ * looked up, then 0 or 1.
+ */
+static int term_ansi = -1;
+
+/**
+ * This function returns true if the terminal understands ANSI escape
+ * sequences. The answer is looked up from TERM once and cached.
+ */
+bool term_isansi()
+{
+    char* term;     /* The terminal type. */
+
+    /* Looking up the terminal type the first time. Terminals without a type
+     * or of the "dumb" type get no escape sequences, as tput would. */
+    if (term_ansi == -1)
+    {
+        term = getenv("TERM");
+        term_ansi = (term != NULL && term[0] != '\0' &&
+                     strcmp(term, "dumb") != 0);
+    }
+
+    return term_ansi;
+}
+
+/**
+ * This function appends an escape sequence, formatted from the format string
+ * and argument list, to the output buffer if the terminal understands them.
+ */
+void term_emit(char* fmt, ...)
+{
+    va_list lp;     /* Pointer to the list of arguments. */
+
+    /* Writing the sequence into stdout's buffer. */
+    if (!term_isansi())
+        return;
+    va_start(lp, fmt);
+    vfprintf(stdout, fmt, lp);
+    va_end(lp);
+}
+
+/**
+ * This function sends everything drawn so far to the terminal.
+ */
+void term_flush()
+{
+    /* Flushing stdout's buffer. */
+    fflush(stdout);
+}
+
 /**
  * This function clears the entire terminal and positions the cursor at home.
  */
 void clear()
 {
     /* Clearing the terminal and putting the cursor at home. */
-    system("tput clear");
+    term_emit("\033[H\033[2J");
 }
 
 /**
@@ -484,7 +1327,7 @@ void clear()
 void clearb()
 {
     /* Clearing from the cursor to the beginning of the line. */
-    system("tput el1");
+    term_emit("\033[1K");
 }
 
 /**
@@ -494,7 +1337,7 @@ void clearb()
 void clearf()
 {
     /* Clearing from the cursor to the end of the line. */
-    system("tput el");
+    term_emit("\033[K");
 }
 
 /**
@@ -509,44 +1352,65 @@ void clearfb()
 }
 
 /**
- * This function returns the number of rows and columns of the terminal.
+ * The cached size of the terminal, whether it is being kept up to date, and
+ * whether the terminal has been resized since.
  */
-vec2d get_res()
-{
-    vec2d res;      /* Storage for the rows and columns. */
-    FILE* rfp;      /* File stream for the rows file. */
-    FILE* cfp;      /* File stream for the columns file. */
-    char rbuf[5];   /* The number of rows. */
-    char cbuf[5];   /* The number of columns. */
-
-    /* Creating a temporary directory to store the files. */
-    system("if [ ! -d temp/ ]; then\nmkdir temp/\nfi");
-
-    /* Writing the number of rows and columns to their files. */
-    system("tput lines >> temp/screen_rows.txt");
-    system("tput cols >> temp/screen_cols.txt");
-
-    /* Opening the files. */
-    rfp = openfs("temp/screen_rows.txt", "r");
-    cfp = openfs("temp/screen_cols.txt", "r");
-
-    /* Getting the number of rows and columns from the files. */
-    fgets(rbuf, sizeof(rbuf), rfp);
-    fgets(cbuf, sizeof(cbuf), cfp);
+static vec2d term_res;
+static bool term_res_ok = false;
+static volatile sig_atomic_t term_resized = 0;
 
-    /* Converting the number of rows and columns to integers. */
-    res.x = atoi(cbuf); //strtol( cbuf, &end, 10 );
-    res.y = atoi(rbuf); //strtol( rbuf, &end, 10 );
+/**
+ * This function is called when the terminal is resized, and marks the cached
+ * size as stale.
+ */
+void on_winch(int sig)
+{
+    term_resized = 1;
+}
 
-    /* Closing the files. */
-    closefs(rfp);
-    closefs(cfp);
+/**
+ * This function returns the number of columns and rows of the terminal.
+ */
+vec2d get_res()
+{
+    struct winsize ws;      /* The size of the terminal. */
+    struct sigaction sa;    /* The SIGWINCH handler. */
+    struct sigaction old;   /* The SIGWINCH handler in place. */
+
+    /* The cached size is used until the terminal is resized. */
+    if (term_res_ok && !term_resized)
+        return term_res;
+
+    /* Refreshing the size on SIGWINCH the first time, unless the program
+     * handles the signal itself, in which case every call asks. */
+    if (!term_res_ok && sigaction(SIGWINCH, NULL, &old) == 0 &&
+        old.sa_handler == SIG_DFL && !(old.sa_flags & SA_SIGINFO))
+    {
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = on_winch;
+        sa.sa_flags = SA_RESTART;
+        sigemptyset(&sa.sa_mask);
+        term_res_ok = (sigaction(SIGWINCH, &sa, NULL) == 0);
+    }
+    term_resized = 0;
 
-    /* Deleting the files. */
-    system("rm -rf temp");
+    /* Asking whichever of the standard streams is a terminal. */
+    if ((ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 ||
+         ioctl(STDIN_FILENO, TIOCGWINSZ, &ws) == 0 ||
+         ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) == 0) &&
+        ws.ws_col > 0 && ws.ws_row > 0)
+    {
+        term_res.x = ws.ws_col;
+        term_res.y = ws.ws_row;
+    }
+    else
+    {
+        term_res.x = 80;
+        term_res.y = 24;
+    }
 
     /* Returning the number of rows and columns that the terminal has. */
-    return res;
+    return term_res;
 }
 
 /**
@@ -556,30 +1420,26 @@ vec2d get_res()
  */
 void move_cursor(enum directions direction, unsigned int n)
 {
-    char* cmd; /* The command. */
+    /* A count of 0 would move the cursor by one. */
+    if (n == 0)
+        return;
 
-    /* Creating the command. */
+    /* Moving the cursor. */
     switch (direction)
     {
         case ABOVE:
-            strfmt(&cmd, "tput cuu %d", n);
+            term_emit("\033[%uA", n);
             break;
         case BELOW:
-            strfmt(&cmd, "tput cud %d", n);
+            term_emit("\033[%uB", n);
             break;
         case BEFORE:
-            strfmt(&cmd, "tput cub %d", n);
+            term_emit("\033[%uD", n);
             break;
         case AFTER:
-            strfmt(&cmd, "tput cuf %d", n);
+            term_emit("\033[%uC", n);
             break;
     }
-
-    /* Moving the cursor. */
-    system(cmd);
-
-    /* Cleaning up. */
-    free(cmd);
 }
 
 /**
@@ -590,35 +1450,32 @@ void move_cursor(enum directions direction, unsigned int n)
 void print_fs_mod(char* filepath, vec2d origin, enum termcolours colour, 
                                                 enum textmodes mode)
 {
-    FILE* fs;   /* Pointer to the file stream. */
-    char* line; /* The text in the file. */
+    FILE* fs;       /* Pointer to the file stream. */
+    linereader lr;  /* Reads the file a line at a time. */
 
-    /* Ensuring that the buffer is set to NULL. */
-    line = NULL;
-    
     /* Opening the file. */ 
     fs = openfs(filepath, "r");
+    linereader_init(&lr, fs);
 
     /* Setting the text mode and foreground colour. */
     text_mode(mode);
     text_fcol(colour);
 
     /* Reading the line from the file. */ 
-    while (readfsl(fs, &line)) 
+    while (linereader_next(&lr)) 
     {
         /* Drawing the line. */
-        print_str(line, origin);
+        print_str(lr.line, origin);
 
         /* Getting ready to draw the next line. */
         origin.y++;
-        free(line);
-        line = NULL;
     }
 
     /* Changing the text-mode and colour back to normal. */
     text_mode(NORMAL);
 
     /* Closing the file. */
+    linereader_free(&lr);
     closefs(fs);
 }
 
@@ -628,15 +1485,9 @@ void print_fs_mod(char* filepath, vec2d origin, enum termcolours colour,
  */
 void print_str(char* str, vec2d pos)
 {
-    char* cmd;  // The command
-
     /* Printing the string. */
     put_cursor(pos.x, pos.y);
-    strfmt(&cmd, "printf \"%s\"", str);
-    system(cmd);
-
-    /* Cleaning up. */
-    free(cmd);
+    fputs(str, stdout);
 }
 
 /**
@@ -665,14 +1516,8 @@ void print_str_mod(char* str, vec2d pos, enum termcolours fcol,
  */
 void put_cursor(unsigned int col, unsigned int row)
 {
-    char* cmd;   /* The command. */
-
-    /* Setting the cursor position. */
-    strfmt(&cmd, "tput cup %d %d", row, col);
-    system(cmd);
-
-    /* Cleaning up. */
-    free(cmd); 
+    /* Setting the cursor position. The terminal counts from 1. */
+    term_emit("\033[%u;%uH", row + 1, col + 1);
 }
 
 /**
@@ -680,14 +1525,8 @@ void put_cursor(unsigned int col, unsigned int row)
  */
 void text_bcol(enum termcolours c)
 {
-    char* cmd;  /* The command. */
-
     /* Setting the background colour. */
-    strfmt(&cmd, "tput setab %d", c);
-    system(cmd);
-
-    /* Cleaning up. */
-    free(cmd);
+    term_emit("\033[4%dm", c);
 }
 
 /**
@@ -695,14 +1534,8 @@ void text_bcol(enum termcolours c)
  */
 void text_fcol(enum termcolours c)
 {
-    char* cmd;   /* The command. */
-
     /* Setting the colour. */
-    strfmt(&cmd, "tput setaf %d", c);
-    system(cmd);
-
-    /* Cleaning up. */
-    free(cmd);
+    term_emit("\033[3%dm", c);
 }
 
 /**
@@ -713,10 +1546,10 @@ void text_mode(enum textmodes m)
     /* Changing the terminal text-mode. */
     switch (m) 
     {
-        case BOLD       : system( "tput bold" ); break;
-        case NORMAL     : system( "tput sgr0" ); break;
-        case BLINK      : system( "tput blink" ); break;
-        case REVERSE    : system( "tput smso" ); break;
-        case UNDERLINE  : system( "tput smul" ); break;
+        case BOLD       : term_emit( "\033[1m" ); break;
+        case NORMAL     : term_emit( "\033[0m" ); break;
+        case BLINK      : term_emit( "\033[5m" ); break;
+        case REVERSE    : term_emit( "\033[7m" ); break;
+        case UNDERLINE  : term_emit( "\033[4m" ); break;
     }
 }
@@ -19,9 +19,18 @@
 #include <stdarg.h>
 #include <time.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <errno.h>
 #include <unistd.h>
 #include <termios.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/uio.h>
 
 /**
  * This is the number of nanoseconds in a second.
@@ -48,20 +57,113 @@ double map(double x, double in_min,  double in_max,
 
 /**
  * This function returns true if a number of nano-seconds equal to or greater
- * than wait_time has elapsed since start.
+ * than wait_time has elapsed since start. start must have been obtained with
+ * start_timer(). deadline_passed() is cheaper for new code.
  */
 bool check_timer(struct timespec ts_start, uint64_t wait_time);
 
 /**
- * This function obtains the current time, storing it in the timespec
- * provided to it.
+ * This function obtains the current time on the monotonic clock, storing it
+ * in the timespec provided to it.
  */
 void start_timer(struct timespec* ts);
 
 /**
- * This function returns a string that represent the current time.
+ * This function returns the number of nanoseconds on the monotonic clock,
+ * which is not affected by changes to the system time. It is read through the
+ * vDSO, so it does not enter the kernel.
+ */
+static inline uint64_t mono_now()
+{
+    struct timespec ts;     /* The current time. */
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * This function returns the number of nanoseconds on the coarse monotonic
+ * clock. It is cheaper than mono_now() but only advances once per scheduler
+ * tick (a few milliseconds), which is enough for most timeouts.
+ */
+static inline uint64_t mono_coarse()
+{
+    struct timespec ts;     /* The current time. */
+
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t) ts.tv_sec * NANOS_PER_SEC + ts.tv_nsec;
+}
+
+/**
+ * This function returns the deadline that is ns nanoseconds from now.
+ */
+static inline uint64_t deadline_in(uint64_t ns)
+{
+    return mono_now() + ns;
+}
+
+/**
+ * This function returns true if the deadline provided to it has passed.
  */
-char* timestamp();
+static inline bool deadline_passed(uint64_t deadline)
+{
+    return mono_now() >= deadline;
+}
+
+/**
+ * This function returns true if the deadline provided to it has passed
+ * according to the coarse clock, which may be a tick behind.
+ */
+static inline bool deadline_passed_coarse(uint64_t deadline)
+{
+    return mono_coarse() >= deadline;
+}
+
+/**
+ * This function creates a timerfd on the monotonic clock and returns its file
+ * descriptor. The timerfd is non-blocking and becomes readable when it
+ * expires, so it can be watched alongside other file descriptors. If there is
+ * an error it is printed on stderr and the program exits.
+ */
+int mktimer();
+
+/**
+ * This function arms the timerfd provided to it to expire when mono_now()
+ * reaches deadline, and then every interval nanoseconds if interval is not 0.
+ * A deadline of 0 disarms the timer.
+ */
+void settimer(int fd, uint64_t deadline, uint64_t interval);
+
+/**
+ * This function returns the number of times the timerfd provided to it has
+ * expired since it was last acknowledged, or 0 if it has not expired.
+ */
+uint64_t acktimer(int fd);
+
+/**
+ * This is the size of buffer that holds a time stamp.
+ */
+#define TIMESTAMP_LEN 40
+
+/**
+ * This function returns a string that represent the current time. The string
+ * belongs to the calling thread and is only reformatted once per second; it
+ * must not be freed and is overwritten by the thread's next call.
+ */
+const char* timestamp();
+
+/**
+ * This function returns a string that represent the current time to the
+ * millisecond. The string is cached in the same way as timestamp().
+ */
+const char* timestamp_ms();
+
+/**
+ * This function copies a string that represent the current time into the
+ * buffer provided to it, which should hold TIMESTAMP_LEN chars, and returns
+ * the buffer.
+ */
+char* timestamp_r(char* buf, size_t size);
 
 /******************************** In/Out *************************************/
 
@@ -92,6 +194,27 @@ void closefs(FILE* fp);
  */
 FILE* openfs(char* fname, char* mode);
 
+/**
+ * Closes the provided file descriptor. If there is an error, it is printed on
+ * stderr and the program will exit.
+ */
+void closefd(int fd);
+
+/**
+ * This function opens a file that has a name that matches fname with open(),
+ * using the flags and permission mode provided to it.
+ * If there is an error it will be printed on stderr and the program
+ * is exited. If the file is successfully opened, this function
+ * will return its file descriptor.
+ */
+int openfd(char* fname, int flags, mode_t mode);
+
+/**
+ * This function is the same as openfd() but opens fname relative to the
+ * directory referred to by dirfd, as openat() does.
+ */
+int openfdat(int dirfd, char* fname, int flags, mode_t mode);
+
 /**
  * This function assigns the next char in the file stream provided to it to
  * the buffer provided to it.
@@ -106,6 +229,77 @@ bool readfsc(FILE* fstreamp, char* buf);
  */
 bool readfsl(FILE* fstreamp, char** buf);
 
+/**
+ * This is a line reader: it reads a file stream a line at a time into a
+ * buffer that it keeps between lines, so reading does not allocate once the
+ * buffer is as long as the longest line.
+ */
+typedef struct {
+    FILE* fs;       /* The file stream being read. */
+    char* line;     /* The current line, including its newline if it has
+                       one. */
+    size_t len;     /* The length of the current line. */
+    size_t size;    /* The size of the buffer. */
+} linereader;
+
+/**
+ * This function initialises the line reader provided to it to read the file
+ * stream provided to it.
+ */
+void linereader_init(linereader* lr, FILE* fstreamp);
+
+/**
+ * This function frees the buffer of the line reader provided to it. The file
+ * stream is not closed.
+ */
+void linereader_free(linereader* lr);
+
+/**
+ * This function reads the next line into the line reader provided to it. It
+ * returns true if a line was read or false if EOF was reached. If an error
+ * occurs the program will exit. The line stays valid until the next call.
+ */
+bool linereader_next(linereader* lr);
+
+/**
+ * This is a view of part of a string: it is not null-terminated and does not
+ * own its chars.
+ */
+typedef struct {
+    const char* ptr;    /* The first char. */
+    size_t len;         /* The number of chars. */
+} strview;
+
+/**
+ * This is a file scanner: it maps a whole file into memory and hands out its
+ * lines as views into the mapping, so scanning does not copy or allocate.
+ */
+typedef struct {
+    char* data;     /* The mapped file, or NULL if it is empty. */
+    size_t size;    /* The size of the file. */
+    size_t pos;     /* Where the next line starts. */
+} fscan;
+
+/**
+ * This function maps the file that has a name that matches fname into the
+ * scanner provided to it. If there is an error it will be printed on stderr
+ * and the program is exited.
+ */
+void fscan_open(fscan* sc, char* fname);
+
+/**
+ * This function unmaps the file of the scanner provided to it. Views of its
+ * lines become invalid.
+ */
+void fscan_close(fscan* sc);
+
+/**
+ * This function points the view provided to it at the next line of the
+ * scanner provided to it, without its newline. It returns true if there was a
+ * line or false if the end of the file was reached.
+ */
+bool fscan_next(fscan* sc, strview* line);
+
 /**
  * This function writes the char provided to it to the file stream provided to
  * it.
@@ -118,6 +312,136 @@ void writefsc(FILE* fstreamp, char ch);
  */
 void writefss(FILE* fstreamp, char* str);
 
+/**
+ * This function writes n bytes from the buffer provided to it to the file
+ * stream provided to it. If there is an error it is printed on stderr and the
+ * program exits.
+ */
+void writefsn(FILE* fstreamp, const void* buf, size_t n);
+
+/**
+ * This function waits until the file descriptor provided to it can be written
+ * to without blocking.
+ */
+void waitwritable(int fd);
+
+/**
+ * This function writes n bytes from the buffer provided to it to the file
+ * descriptor provided to it, carrying on after short writes and signals. A
+ * non-blocking file descriptor that is full is waited for. If there is an
+ * error it is printed on stderr and the program exits.
+ */
+void writefd(int fd, const void* buf, size_t n);
+
+/**
+ * This function writes the cnt buffers described by iov to the file descriptor
+ * provided to it with as few writev() calls as it can, carrying on after
+ * short writes and signals, and waiting for a non-blocking file descriptor
+ * that is full. The iovecs are used up as they are written. If
+ * there is an error it is printed on stderr and the program exits.
+ */
+void writefdv(int fd, struct iovec* iov, int cnt);
+
+/**
+ * This is an output buffer: writes to a file descriptor are gathered in a
+ * buffer supplied by the caller, or allocated, and sent when it is full or
+ * flushed. Writes too big for the buffer are sent together with what is
+ * buffered in one writev().
+ */
+typedef struct {
+    int fd;         /* The file descriptor written to. */
+    char* buf;      /* The buffer. */
+    size_t size;    /* The size of the buffer. */
+    size_t len;     /* The number of bytes in the buffer. */
+    bool heap;      /* Whether the buffer was allocated. */
+} outbuf;
+
+/**
+ * This is the size of the buffer outbuf_init() allocates if it is not given
+ * one.
+ */
+#define OUTBUF_LEN 65536
+
+/**
+ * This function initialises the output buffer provided to it to write to fd.
+ * It uses the buffer provided, or allocates size bytes (OUTBUF_LEN if size is
+ * 0) if buf is NULL.
+ */
+void outbuf_init(outbuf* ob, int fd, char* buf, size_t size);
+
+/**
+ * This function flushes the output buffer provided to it and frees the memory
+ * it allocated. The file descriptor is not closed.
+ */
+void outbuf_free(outbuf* ob);
+
+/**
+ * This function appends n bytes from the buffer provided to it to the output
+ * buffer provided to it.
+ */
+void outbuf_write(outbuf* ob, const void* data, size_t n);
+
+/**
+ * This function appends the cnt buffers described by iov to the output buffer
+ * provided to it.
+ */
+void outbuf_writev(outbuf* ob, const struct iovec* iov, int cnt);
+
+/**
+ * This function sends everything in the output buffer provided to it.
+ */
+void outbuf_flush(outbuf* ob);
+
+
+/******************************** Memory *************************************/
+
+/**
+ * This is an arena: a block of memory that short-lived allocations are
+ * carved out of, and that is emptied all at once with arena_reset() instead
+ * of freeing each allocation.
+ */
+typedef struct {
+    char* base;     /* The block. */
+    size_t size;    /* The size of the block. */
+    size_t used;    /* The number of bytes handed out from the block. */
+    void* extra;    /* Blocks allocated when the block ran out of room. */
+    size_t spilled; /* The number of bytes handed out from extra blocks. */
+} arena;
+
+/**
+ * This function initialises the arena provided to it with a block of size
+ * bytes. If there is an error it is printed on stderr and the program exits.
+ */
+void arena_init(arena* a, size_t size);
+
+/**
+ * This function frees the memory of the arena provided to it.
+ */
+void arena_free(arena* a);
+
+/**
+ * This function returns n bytes from the arena provided to it, aligned for
+ * any type. If the block is full an extra block is allocated; the next
+ * arena_reset() grows the block so that the extra blocks are not needed again.
+ */
+void* arena_alloc(arena* a, size_t n);
+
+/**
+ * This function empties the arena provided to it. Everything allocated from
+ * it becomes invalid.
+ */
+void arena_reset(arena* a);
+
+/**
+ * This function formats a string in the same way as strfmt(), but takes the
+ * memory for it from the arena provided to it and returns the string.
+ */
+char* astrfmt(arena* a, char* fmt, ...);
+
+/**
+ * This function is the same as astrfmt() but takes a variable argument list.
+ */
+char* vastrfmt(arena* a, char* fmt, va_list lp);
 
 /******************************** Strings ************************************/
 
@@ -135,18 +459,87 @@ size_t vbytesfmt(va_list lp, char* fmt);
  */
 void strfmt(char** sp, char *fmt, ...);
 
+/**
+ * This is the size of the stack buffer strfmt() tries to format into before
+ * it allocates.
+ */
+#define STRFMT_STACK_LEN 256
+
+/**
+ * This is a string builder. It appends to a buffer supplied by the caller,
+ * which may be on the stack, and only moves the string to the heap if it
+ * outgrows that buffer.
+ */
+typedef struct {
+    char* str;      /* The string, always null-terminated once used. */
+    size_t len;     /* The length of the string. */
+    size_t size;    /* The number of bytes available to the string. */
+    bool heap;      /* Whether the builder allocated str. */
+} strbuf;
+
+/**
+ * This function initialises the string builder provided to it. The builder
+ * starts out using the buffer provided, which may be on the stack, and only
+ * moves to the heap if the string outgrows it. buf may be NULL.
+ */
+void strbuf_init(strbuf* sb, char* buf, size_t size);
+
+/**
+ * This function frees the memory that the string builder provided to it
+ * allocated.
+ */
+void strbuf_free(strbuf* sb);
+
+/**
+ * This function empties the string builder provided to it, keeping its
+ * memory.
+ */
+void strbuf_reset(strbuf* sb);
+
+/**
+ * This function makes sure the string builder provided to it has room for n
+ * more chars and the null character.
+ */
+void strbuf_reserve(strbuf* sb, size_t n);
+
+/**
+ * This function appends n chars from the string provided to it to the
+ * string builder provided to it.
+ */
+void strbuf_cat(strbuf* sb, const char* str, size_t n);
+
+/**
+ * This function appends text to the string builder provided to it, formatted
+ * from the format string and argument list. The text is formatted once unless
+ * it does not fit in the memory the builder already has.
+ */
+void strbuf_fmt(strbuf* sb, char* fmt, ...);
+
+/**
+ * This function is the same as strbuf_fmt() but takes a variable argument
+ * list.
+ */
+void strbuf_vfmt(strbuf* sb, char* fmt, va_list lp);
+
 /**
  * This function removes the char element from the string provided to it which
- * is at the element number provided to it.
+ * is at the element number provided to it. The string is edited in place.
  */
 void sdelelem(char** sp, unsigned elem);
 
 /**
  * This function removes all cases of the provided char from the string at the
- * provided pointer.
+ * provided pointer. The string is edited in place.
  */
 void sdelchar(char** sp, char remove);
 
+/**
+ * This function removes every char that is in the set provided to it from the
+ * string provided to it, in place and in a single pass, and returns the new
+ * length of the string.
+ */
+size_t sdelchars(char* str, char* set);
+
 /**
  * This function removes the last character before the null character
  * from the string at the string pointer provided to it.
@@ -184,6 +577,30 @@ enum textmodes {
     UNDERLINE
     };
 
+/**
+ * The terminal functions below write ANSI escape sequences into stdout's
+ * buffer instead of running tput, so a whole frame can be drawn and then sent
+ * with a single term_flush(). Nothing is drawn if TERM is unset or "dumb".
+ */
+
+/**
+ * This function returns true if the terminal understands ANSI escape
+ * sequences. The answer is looked up from TERM once and cached.
+ */
+bool term_isansi();
+
+/**
+ * This function appends an escape sequence, formatted from the format string
+ * and argument list, to the output buffer if the terminal understands them.
+ */
+void term_emit(char* fmt, ...);
+
+/**
+ * This function sends everything drawn so far to the terminal. Call it once
+ * per frame.
+ */
+void term_flush();
+
 /**
  * This function clears the terminal.
  */
@@ -208,7 +625,10 @@ void clearf();
 void clearfb();
 
 /**
- * This function returns the number of rows and columns of the terminal.
+ * This function returns the number of columns (x) and rows (y) of the
+ * terminal. The size is asked for once and cached; a SIGWINCH handler is
+ * installed, unless the program has its own, to refresh it when the terminal
+ * is resized. If the size cannot be found, 80 by 24 is returned.
  */
 vec2d get_res();
 
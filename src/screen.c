@@ -0,0 +1,371 @@
+/**
+ * screen.c
+ *
+ * This file contains the internal data and function definitions for the
+ * screen type.
+ *
+ * The screen type is a double-buffered terminal renderer. Text is drawn into
+ * a back buffer of cells, and refreshing the screen sends only the cells that
+ * differ from what the terminal already shows.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "screen.h"
+
+/**
+ * This is the largest number of unchanged cells that are redrawn to join two
+ * runs of changed cells on a row, as that is cheaper than moving the cursor
+ * over them.
+ */
+#define SCREEN_MAX_GAP 4
+
+/**
+ * This is one character cell of the screen.
+ */
+struct screen_cell {
+    char ch;            /* The character, or '\0' if never drawn. */
+    unsigned char fg;   /* The foreground colour. */
+    unsigned char bg;   /* The background colour. */
+    unsigned char mode; /* The text mode. */
+};
+
+/**
+ * This is the internal data contained within the screen type.
+ */
+struct screen_data {
+    struct screen_cell* back;   /* What the next refresh should show. */
+    struct screen_cell* front;  /* What the terminal shows. */
+    int cols;                   /* The number of columns. */
+    int rows;                   /* The number of rows. */
+    strbuf out;                 /* The bytes of the frame being sent. */
+};
+
+/**
+ * These are the SGR parameters of the text modes, indexed by textmodes.
+ */
+static const int screen_modes[] = { 1, 0, 5, 7, 4 };
+
+/**
+ * This function fills n cells with the cell provided to it.
+ */
+void cells_fill(struct screen_cell* cells, size_t n, struct screen_cell c)
+{
+    size_t i;   /* Index of the current cell. */
+
+    for (i = 0; i < n; i++)
+        cells[i] = c;
+}
+
+/**
+ * This function returns true if two cells look the same.
+ */
+bool cells_eq(struct screen_cell* a, struct screen_cell* b)
+{
+    return a->ch == b->ch && a->fg == b->fg && a->bg == b->bg &&
+           a->mode == b->mode;
+}
+
+/**
+ * This function allocates the buffers of the screen provided to it for the
+ * size provided, blanking the back buffer and invalidating the front one.
+ */
+void screen_alloc(struct screen_data* scr, vec2d size)
+{
+    vec2d res;  /* The size of the terminal. */
+    size_t n;   /* The number of cells. */
+
+    /* Use the size of the terminal for anything left as 0. */
+    if (size.x <= 0 || size.y <= 0)
+    {
+        res = get_res();
+        size.x = (size.x > 0) ? size.x : res.x;
+        size.y = (size.y > 0) ? size.y : res.y;
+    }
+    scr->cols = (size.x > 0) ? size.x : 0;
+    scr->rows = (size.y > 0) ? size.y : 0;
+
+    /* Allocate the buffers. */
+    n = (size_t) scr->cols * (size_t) scr->rows;
+    scr->back = (struct screen_cell*) malloc(sizeof(struct screen_cell) * n);
+    scr->front = (struct screen_cell*) malloc(sizeof(struct screen_cell) * n);
+
+    /* Start with a blank back buffer and a front buffer that matches
+     * nothing. */
+    screen_clear(&scr);
+    screen_invalidate(&scr);
+}
+
+/**
+ * This function initialises the screen provided to it.
+ */
+void screen_init(screen* scr, vec2d size)
+{
+    /* Allocate memory to the screen. */
+    *scr = (screen) malloc(sizeof(struct screen_data));
+
+    /* Allocate the cells and the output buffer. */
+    screen_alloc(*scr, size);
+    strbuf_init(&(*scr)->out, NULL, 0);
+}
+
+/**
+ * This function destroys the screen provided to it.
+ */
+void screen_free(screen* scr)
+{
+    /* De-allocate memory from the screen. */
+    strbuf_free(&(*scr)->out);
+    free((*scr)->back);
+    free((*scr)->front);
+    free(*scr);
+}
+
+/**
+ * This function changes the size of the screen provided to it.
+ */
+void screen_resize(screen* scr, vec2d size)
+{
+    /* Replace the buffers. */
+    free((*scr)->back);
+    free((*scr)->front);
+    screen_alloc(*scr, size);
+}
+
+/**
+ * This function returns the number of columns and rows of the screen.
+ */
+vec2d screen_size(screen* scr)
+{
+    vec2d size;     /* The size of the screen. */
+
+    size.x = (*scr)->cols;
+    size.y = (*scr)->rows;
+
+    return size;
+}
+
+/**
+ * This function blanks the back buffer of the screen provided to it.
+ */
+void screen_clear(screen* scr)
+{
+    struct screen_cell blank = { ' ', SCREEN_DEFCOL, SCREEN_DEFCOL, NORMAL };
+
+    cells_fill((*scr)->back, (size_t) (*scr)->cols * (size_t) (*scr)->rows,
+               blank);
+}
+
+/**
+ * This function makes the next refresh redraw every cell.
+ */
+void screen_invalidate(screen* scr)
+{
+    struct screen_cell none = { '\0', SCREEN_DEFCOL, SCREEN_DEFCOL, NORMAL };
+
+    cells_fill((*scr)->front, (size_t) (*scr)->cols * (size_t) (*scr)->rows,
+               none);
+}
+
+/**
+ * This function puts a char into the back buffer at the position provided to
+ * it.
+ */
+void screen_putc(screen* scr, char ch, vec2d pos, enum termcolours fcol,
+                              enum termcolours bcol, enum textmodes mode)
+{
+    struct screen_cell* c;  /* The cell being drawn. */
+
+    /* Ignore positions off the screen. */
+    if (pos.x < 0 || pos.y < 0 || pos.x >= (*scr)->cols ||
+        pos.y >= (*scr)->rows)
+        return;
+
+    /* Draw the char. Anything that is not printable ASCII is drawn as a
+     * space, as it would throw out the cursor position. */
+    c = &(*scr)->back[(size_t) pos.y * (*scr)->cols + pos.x];
+    c->ch = (ch >= ' ' && ch < 0x7f) ? ch : ' ';
+    c->fg = (unsigned char) fcol;
+    c->bg = (unsigned char) bcol;
+    c->mode = (unsigned char) mode;
+}
+
+/**
+ * This function draws the string provided to it into the back buffer.
+ */
+void screen_print(screen* scr, char* str, vec2d origin, enum termcolours fcol,
+                               enum termcolours bcol, enum textmodes mode)
+{
+    vec2d pos = origin;     /* Where the next char goes. */
+
+    for (; *str != '\0'; str++)
+    {
+        /* Carry on at the start of the next row after a newline. */
+        if (*str == '\n')
+        {
+            pos.x = origin.x;
+            pos.y++;
+            continue;
+        }
+
+        /* Draw the char. */
+        screen_putc(scr, *str, pos, fcol, bcol, mode);
+        pos.x++;
+    }
+}
+
+/**
+ * This function draws the text file at the file path provided to it into the
+ * back buffer.
+ */
+void screen_print_fs(screen* scr, char* filepath, vec2d origin,
+                     enum termcolours fcol, enum textmodes mode)
+{
+    FILE* fs;       /* Pointer to the file stream. */
+    linereader lr;  /* Reads the file a line at a time. */
+
+    /* Opening the file. */
+    fs = openfs(filepath, "r");
+    linereader_init(&lr, fs);
+
+    /* Drawing the file a line at a time. */
+    while (linereader_next(&lr))
+    {
+        screen_print(scr, lr.line, origin, fcol, SCREEN_DEFCOL, mode);
+        origin.y++;
+    }
+
+    /* Closing the file. */
+    linereader_free(&lr);
+    closefs(fs);
+}
+
+/**
+ * This function appends the SGR sequence that changes the attributes of the
+ * terminal from cur to those of the cell c, and updates cur. If known is false
+ * the terminal's attributes are not known and are reset first.
+ */
+void screen_sgr(strbuf* out, struct screen_cell* cur, bool* known,
+                                                      struct screen_cell* c)
+{
+    char* sep = "";     /* What goes before the next parameter. */
+
+    /* Nothing to do if the attributes are the same. */
+    if (*known && c->fg == cur->fg && c->bg == cur->bg && c->mode == cur->mode)
+        return;
+
+    strbuf_cat(out, "\033[", 2);
+
+    /* A mode cannot be switched off on its own, so reset everything. */
+    if (!*known || c->mode != cur->mode)
+    {
+        strbuf_cat(out, "0", 1);
+        if (c->mode != NORMAL)
+            strbuf_fmt(out, ";%d", screen_modes[c->mode]);
+        sep = ";";
+        cur->fg = SCREEN_DEFCOL;
+        cur->bg = SCREEN_DEFCOL;
+        cur->mode = c->mode;
+        *known = true;
+    }
+
+    /* Change the colours that differ. */
+    if (c->fg != cur->fg)
+    {
+        strbuf_fmt(out, "%s3%d", sep, c->fg);
+        sep = ";";
+    }
+    if (c->bg != cur->bg)
+        strbuf_fmt(out, "%s4%d", sep, c->bg);
+    strbuf_cat(out, "m", 1);
+
+    cur->fg = c->fg;
+    cur->bg = c->bg;
+}
+
+/**
+ * This function sends the cells of the back buffer that differ from what the
+ * terminal shows, and returns the number of bytes sent.
+ */
+size_t screen_refresh(screen* scr)
+{
+    struct screen_data* s = *scr;       /* The screen. */
+    struct screen_cell cur;             /* The terminal's attributes. */
+    bool known;                         /* Whether cur is known. */
+    struct screen_cell* back;           /* The row of the back buffer. */
+    struct screen_cell* front;          /* The row of the front buffer. */
+    int curx;                           /* The cursor's column, or -1. */
+    int cury;                           /* The cursor's row, or -1. */
+    int x;                              /* Column of the current cell. */
+    int y;                              /* Row of the current cell. */
+    int end;                            /* End of the run being sent. */
+    int i;                              /* Column of the cell being looked
+                                           at. */
+
+    /* Nothing can be drawn without escape sequences. */
+    if (!term_isansi())
+        return 0;
+
+    /* Nothing is known about the terminal's cursor or attributes. */
+    strbuf_reset(&s->out);
+    known = false;
+    curx = -1;
+    cury = -1;
+
+    for (y = 0; y < s->rows; y++)
+    {
+        back = s->back + (size_t) y * s->cols;
+        front = s->front + (size_t) y * s->cols;
+
+        for (x = 0; x < s->cols;)
+        {
+            /* Skip cells the terminal already shows. */
+            if (cells_eq(&back[x], &front[x]))
+            {
+                x++;
+                continue;
+            }
+
+            /* Find the end of the run, joining runs separated by only a few
+             * unchanged cells. */
+            for (end = x + 1, i = x + 1;
+                 i < s->cols && i - end <= SCREEN_MAX_GAP; i++)
+                if (!cells_eq(&back[i], &front[i]))
+                    end = i + 1;
+
+            /* Move the cursor to the start of the run. */
+            if (cury != y || curx == -1 || curx > x)
+                strbuf_fmt(&s->out, "\033[%d;%dH", y + 1, x + 1);
+            else if (curx < x)
+                strbuf_fmt(&s->out, "\033[%dC", x - curx);
+
+            /* Send the run. */
+            for (; x < end; x++)
+            {
+                screen_sgr(&s->out, &cur, &known, &back[x]);
+                strbuf_cat(&s->out, &back[x].ch, 1);
+                front[x] = back[x];
+            }
+
+            /* After the last column the cursor may be waiting to wrap, so
+             * its position is not known. */
+            curx = (end < s->cols) ? end : -1;
+            cury = y;
+        }
+    }
+
+    /* Leave the terminal's attributes as they were. */
+    if (known && (cur.mode != NORMAL || cur.fg != SCREEN_DEFCOL ||
+                  cur.bg != SCREEN_DEFCOL))
+        strbuf_cat(&s->out, "\033[0m", 4);
+
+    /* Send the frame with one write. */
+    if (s->out.len > 0)
+    {
+        fwrite(s->out.str, 1, s->out.len, stdout);
+        fflush(stdout);
+    }
+
+    return s->out.len;
+}
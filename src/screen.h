@@ -0,0 +1,99 @@
+/**
+ * screen.h
+ *
+ * This file contains the publicly available data-structure and function
+ * prototype declarations for the screen type.
+ *
+ * The screen type is a double-buffered terminal renderer. Text is drawn into
+ * a back buffer of cells, and refreshing the screen sends only the cells that
+ * differ from what the terminal already shows.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#ifndef SCREEN_H
+#define SCREEN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "mycutils.h"
+
+/**
+ * This is the colour that leaves the terminal's own colour in place. It can
+ * be used wherever a termcolours value is expected.
+ */
+#define SCREEN_DEFCOL 9
+
+/**
+ * This is the screen data-structure.
+ */
+typedef struct screen_data* screen;
+
+/**
+ * This function initialises the screen provided to it with size.x columns
+ * and size.y rows. A size of 0 in either direction means the size of the
+ * terminal. The back buffer starts out blank.
+ */
+void screen_init(screen* scr, vec2d size);
+
+/**
+ * This function destroys the screen provided to it.
+ */
+void screen_free(screen* scr);
+
+/**
+ * This function changes the size of the screen provided to it, as
+ * screen_init() does. The back buffer is blanked and the next refresh redraws
+ * every cell.
+ */
+void screen_resize(screen* scr, vec2d size);
+
+/**
+ * This function returns the number of columns and rows of the screen.
+ */
+vec2d screen_size(screen* scr);
+
+/**
+ * This function blanks the back buffer of the screen provided to it.
+ */
+void screen_clear(screen* scr);
+
+/**
+ * This function makes the next refresh redraw every cell, for when the
+ * terminal has been drawn on by something else.
+ */
+void screen_invalidate(screen* scr);
+
+/**
+ * This function puts a char into the back buffer at the position provided to
+ * it, in the colours and mode provided. Positions off the screen are ignored.
+ */
+void screen_putc(screen* scr, char ch, vec2d pos, enum termcolours fcol,
+                              enum termcolours bcol, enum textmodes mode);
+
+/**
+ * This function draws the string provided to it into the back buffer, starting
+ * at origin, in the colours and mode provided. A newline carries on at
+ * origin.x on the next row, and text off the screen is clipped.
+ */
+void screen_print(screen* scr, char* str, vec2d origin, enum termcolours fcol,
+                               enum termcolours bcol, enum textmodes mode);
+
+/**
+ * This function draws the text file at the file path provided to it into the
+ * back buffer, as print_fs_mod() draws it to the terminal.
+ */
+void screen_print_fs(screen* scr, char* filepath, vec2d origin,
+                     enum termcolours fcol, enum textmodes mode);
+
+/**
+ * This function sends the cells of the back buffer that differ from what the
+ * terminal shows, with one write, and returns the number of bytes sent.
+ */
+size_t screen_refresh(screen* scr);
+
+#endif // SCREEN_H
@@ -10,16 +10,208 @@
  * Version: 1.0.1
  */
 
+#define _GNU_SOURCE
+
 #include "subproc.h"
 
+#include <limits.h>
+
+/**
+ * This is the environment of the program, which is handed to sub-processes.
+ */
+extern char** environ;
+
+/**
+ * This is a ring buffer holding the most recent bytes of a stream. Its memory
+ * is mapped twice in a row, so any run of up to size bytes starting inside
+ * the first mapping is contiguous. It is written by one thread and may be
+ * read by others without locking.
+ */
+struct ring {
+    char* base;                 /* The start of the first mapping. */
+    size_t size;                /* The size of the ring, a power of two. */
+    _Atomic uint64_t head;      /* The number of bytes ever written. */
+};
+
+/**
+ * This is an output stream of a sub-process that the parent reads through a
+ * pipe, keeping it in memory and/or passing it on to other file descriptors.
+ */
+struct capture {
+    int fd;         /* The read end of the stream's pipe, or -1. */
+    bool keep;      /* Whether the stream is kept in memory. */
+    char* data;     /* The bytes that have been captured. */
+    size_t len;     /* The number of bytes that have been captured. */
+    size_t size;    /* The number of bytes allocated to data. */
+    size_t max;     /* The most bytes to keep, or 0 for no limit. */
+    int sinks[SUBPROC_MAX_SINKS];   /* Where the stream is passed on to. */
+    size_t nsinks;  /* The number of sinks. */
+    int tmp[2];     /* A pipe the stream is duplicated into with tee(). */
+    struct ring* tail;  /* Keeps the most recent bytes instead of data. */
+};
+
+/**
+ * This is the cgroup a sub-process is placed in. The files its usage is read
+ * from are kept open.
+ */
+struct cgroup {
+    int fd;         /* The cgroup's directory, or -1 if there is none. */
+    char* path;     /* The path of the cgroup's directory. */
+    int cpustat;    /* cpu.stat, or -1. */
+    int memcur;     /* memory.current, or -1. */
+    int mempeak;    /* memory.peak, or -1. */
+};
+
+/**
+ * These are the arguments of clone3(), laid out as the kernel expects them.
+ */
+struct clone3_args {
+    uint64_t flags;         /* The CLONE_* flags. */
+    uint64_t pidfd;         /* Where to store the pidfd. */
+    uint64_t child_tid;     /* Where to store the child's thread id. */
+    uint64_t parent_tid;    /* Where to store the child's thread id. */
+    uint64_t exit_signal;   /* The signal sent when the child exits. */
+    uint64_t stack;         /* The child's stack. */
+    uint64_t stack_size;    /* The size of the child's stack. */
+    uint64_t tls;           /* The child's thread-local storage. */
+    uint64_t set_tid;       /* The thread ids to use. */
+    uint64_t set_tid_size;  /* The number of thread ids. */
+    uint64_t cgroup;        /* The cgroup to start the child in. */
+};
+
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP 0x200000000ULL
+#endif
+
+/**
+ * This is a piece of input queued for the stdin of a sub-process: bytes
+ * copied from memory, or part of a file to splice from.
+ */
+struct chunk {
+    struct chunk* next; /* The next piece of input. */
+    int src;            /* The file to splice from, or -1. */
+    size_t len;         /* The number of bytes left to write. */
+    size_t off;         /* The number of bytes written from data. */
+    char data[];        /* The bytes, if they came from memory. */
+};
+
+/**
+ * This is the stdin of a sub-process that the parent writes to through a
+ * pipe.
+ */
+struct feed {
+    bool enabled;       /* Whether the sub-process gets a pipe. */
+    int fd;             /* The write end of the pipe, or -1. */
+    size_t max;         /* The most bytes to hold in memory. */
+    size_t queued;      /* The number of bytes held in memory. */
+    struct chunk* head; /* The first piece of input. */
+    struct chunk* tail; /* The last piece of input. */
+    bool closing;       /* Whether to close the pipe once it is empty. */
+    bool armed;         /* Whether the evloop is waiting for EPOLLOUT. */
+    bool feeding;       /* Whether fn is running. */
+    bool fed;           /* Whether fn offered any input. */
+    subproc_feedfn fn;  /* Called when the queue empties. */
+    void* arg;          /* The argument to pass to fn. */
+};
+
 /**
  * This is the internal data contained within the subproc type.
  */
 struct subproc_data {
-    int fds[2]; /* File descriptors. */
-    pid_t pid;  /* Process Id. */
+    struct feed in;     /* The stdin of the process. */
+    pid_t pid;          /* Process Id. */
+    char* cwd;          /* Working directory of the sub-process. */
+    int pidfd;          /* File descriptor referring to the process. */
+    bool running;       /* Whether the process has yet to be reaped. */
+    int status;         /* The status the process exited with. */
+    subproc self;       /* This subproc, handed to callbacks. */
+    evloop* ev;         /* The evloop watching the process, or NULL. */
+    subproc_exitfn fn;  /* Called when the process has been reaped. */
+    void* arg;          /* The argument to pass to fn. */
+    struct capture out; /* The captured stdout. */
+    struct capture err; /* The captured stderr. */
+    arena scratch;      /* Memory for the strings built by a launch. */
+    struct cgroup cg;   /* The cgroup the process is placed in. */
+    subproc_metrics m;  /* What the last run of the process cost. */
+    uint64_t start_ns;  /* When the process was started. */
+    uint64_t interval;  /* How often to sample /proc, or 0. */
+    evloop_timer sampler;   /* The timer sampling /proc, or NULL. */
+    int statfd;         /* /proc/<pid>/stat, or -1. */
+    int iofd;           /* /proc/<pid>/io, or -1. */
+    subproc_termpolicy term;    /* How the process is terminated. */
+    size_t termstep;            /* The next step of the policy. */
+    evloop_timer termtimer;     /* Times the next step, or NULL. */
+    bool terminating;           /* Whether the process is being
+                                   terminated. */
+    enum subproc_group group;   /* The group to start the process in. */
+    bool leader;                /* Whether the process leads its group. */
+    bool suspended;             /* Whether the process was stopped. */
+    bool numbered;              /* Whether output files are numbered by
+                                   launch. */
+    int redir[3];       /* What the next launch connects stdin, stdout and
+                           stderr to instead, or -1. */
+};
+
+/**
+ * This is the list of sub-processes that are watched through SIGCHLD because
+ * pidfds are not available.
+ */
+struct sigchld_list {
+    int fd;             /* The signalfd receiving SIGCHLD, or -1. */
+    subproc* sps;       /* The watched sub-processes. */
+    size_t len;         /* The number of watched sub-processes. */
+    size_t cap;         /* The number of slots in the list. */
 };
 
+/**
+ * The sub-processes watched through SIGCHLD.
+ */
+static struct sigchld_list sigchld = { -1, NULL, 0, 0 };
+
+/**
+ * Whether clone3() may be available. It is cleared the first time the kernel
+ * says it is not.
+ */
+static bool clone3_ok = true;
+
+/**
+ * Whether SIGPIPE was ignored for the stdin pipes, in which case children
+ * have its default action restored.
+ */
+static bool sigpipe_ignored = false;
+
+/**
+ * This function closes the pipes of a stream.
+ */
+void capture_close(struct capture* cap, evloop* ev);
+
+/**
+ * This function destroys a ring buffer.
+ */
+void ring_free(struct ring* r);
+
+/**
+ * This function closes the files of a cgroup and removes it.
+ */
+void cgroup_remove(struct cgroup* cg);
+
+/**
+ * This function closes the stdin pipe of a sub-process and empties its
+ * queue.
+ */
+void feed_close(subproc* sp);
+
+/**
+ * This function stops a sub-process from being watched and closes its pidfd.
+ */
+void unwatch(subproc* sp);
+void detach(subproc* sp);
+
+/**
+ * This function ignores SIGPIPE unless the program handles it.
+ */
+void ignore_sigpipe();
+
 /**
  * This function initialises the subproc provided to it.
  */
@@ -27,6 +219,44 @@ void subproc_init(subproc* sp)
 {
     /* Allocate memory to the subroc. */
     *sp = (subproc) malloc(sizeof(struct subproc_data));
+
+    /* Initialise the subproc's data. */
+    memset(&(*sp)->in, 0, sizeof(struct feed));
+    (*sp)->in.fd = -1;
+    (*sp)->pid = -1;
+    (*sp)->cwd = NULL;
+    (*sp)->pidfd = -1;
+    (*sp)->running = false;
+    (*sp)->status = 0;
+    (*sp)->self = *sp;
+    (*sp)->ev = NULL;
+    (*sp)->fn = NULL;
+    (*sp)->arg = NULL;
+    memset(&(*sp)->out, 0, sizeof(struct capture));
+    memset(&(*sp)->err, 0, sizeof(struct capture));
+    (*sp)->out.fd = -1;
+    (*sp)->err.fd = -1;
+    (*sp)->out.tmp[0] = (*sp)->out.tmp[1] = -1;
+    (*sp)->err.tmp[0] = (*sp)->err.tmp[1] = -1;
+    arena_init(&(*sp)->scratch, 1024);
+    (*sp)->cg.fd = -1;
+    (*sp)->cg.path = NULL;
+    (*sp)->cg.cpustat = (*sp)->cg.memcur = (*sp)->cg.mempeak = -1;
+    memset(&(*sp)->m, 0, sizeof(subproc_metrics));
+    (*sp)->start_ns = 0;
+    (*sp)->interval = 0;
+    (*sp)->sampler = NULL;
+    (*sp)->statfd = -1;
+    (*sp)->iofd = -1;
+    subproc_setterm(sp, NULL);
+    (*sp)->termstep = 0;
+    (*sp)->termtimer = NULL;
+    (*sp)->numbered = false;
+    (*sp)->terminating = false;
+    (*sp)->group = SUBPROC_INHERIT;
+    (*sp)->leader = false;
+    (*sp)->suspended = false;
+    (*sp)->redir[0] = (*sp)->redir[1] = (*sp)->redir[2] = -1;
 }
 
 /**
@@ -34,207 +264,2484 @@ void subproc_init(subproc* sp)
  */
 void subproc_free(subproc* sp)
 {
+    int i;  /* Index of the current redirection. */
+
+    /* Close the redirections that were never used. */
+    for (i = 0; i < 3; i++)
+        if ((*sp)->redir[i] != -1)
+            closefd((*sp)->redir[i]);
+
+    /* Stop the evloop from watching anything of the process, so it is not
+     * left holding the freed subproc. */
+    detach(sp);
+
     /* De-allocate memory from the subroc. */
+    ring_free((*sp)->out.tail);
+    ring_free((*sp)->err.tail);
+    free((*sp)->out.data);
+    free((*sp)->err.data);
+    free((*sp)->cwd);
+    arena_free(&(*sp)->scratch);
+    cgroup_remove(&(*sp)->cg);
     free(*sp);
 }
 
 /**
- * This function duplicates the "old" file descriptor provided to it. If there
+ * This function sets the working directory that the sub-process will be
+ * started in. Passing NULL makes the sub-process inherit the working directory
+ * of its parent.
+ */
+void subproc_chdir(subproc* sp, char* dir)
+{
+    /* Replace the previous working directory. */
+    free((*sp)->cwd);
+    (*sp)->cwd = NULL;
+    if (dir != NULL)
+        strfmt(&(*sp)->cwd, "%s", dir);
+}
+
+/**
+ * This function sets whether the output files of the sub-process are named
+ * with the number of the launch as well as the command, from the next time it
+ * is executed.
+ */
+void subproc_numberfiles(subproc* sp, bool numbered)
+{
+    /* Set the naming of the files. */
+    (*sp)->numbered = numbered;
+}
+
+/**
+ * This function makes the sub-process's stdout and stderr be captured in
+ * memory instead of being written to files.
+ */
+void subproc_capture(subproc* sp, size_t max)
+{
+    /* Enable capturing. */
+    (*sp)->out.keep = true;
+    (*sp)->err.keep = true;
+    (*sp)->out.max = max;
+    (*sp)->err.max = max;
+}
+
+/**
+ * This function creates a ring buffer that holds at least size bytes. If there
  * is an error it is printed on stderr and the program exits.
- *
- * dup2() is used to specify the file descriptor being used for a pipe(),
- * file stream, etc...
  */
-void duperr(int fdold, int fdnew)
+struct ring* ring_init(size_t size)
 {
-    /* Attempting to duplicate the file descriptor. */
-    if (dup2(fdold, fdnew) == -1) 
-    {    
-        /* There was an error duplicating the file descriptor so print it and
-         * exit the program. */
-        fprintf(stderr, 
-                "[ %s ] dup2 failed on fileno() %s\n", 
+    struct ring* r;     /* The ring buffer. */
+    size_t page;        /* The size of a page. */
+    int fd;             /* The memory backing the ring. */
+
+    /* Round the size up to a power of two that is at least a page. */
+    page = (size_t) sysconf(_SC_PAGESIZE);
+    r = (struct ring*) malloc(sizeof(struct ring));
+    for (r->size = page; r->size < size; r->size *= 2);
+    atomic_init(&r->head, 0);
+
+    /* Reserve room for two copies, then map the same memory into both. */
+    if ((fd = memfd_create("subproc_tail", MFD_CLOEXEC)) == -1 ||
+        ftruncate(fd, r->size) == -1 ||
+        (r->base = mmap(NULL, r->size * 2, PROT_NONE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0)) == MAP_FAILED ||
+        mmap(r->base, r->size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+        mmap(r->base + r->size, r->size, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    {
+        /* There was an error mapping the ring so print it and exit the
+         * program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In ring_init(): %s\n",
                 timestamp(), strerror(errno));
         exit(EXIT_FAILURE);
     }
+
+    /* The mappings keep the memory alive. */
+    closefd(fd);
+
+    return r;
 }
 
 /**
- * This function creates a file name from a directory path, a shell command,
- * and a file extension.
+ * This function destroys a ring buffer.
  */
-void mkfname(char** sp, char* dir, char* cmd, char* ext)
+void ring_free(struct ring* r)
 {
-    /* Remove unwanted characters from the copy. */
-    sdelchar(&cmd, '/');
-    sdelchar(&cmd, '.');
+    if (r == NULL)
+        return;
+    munmap(r->base, r->size * 2);
+    free(r);
+}
 
-    /* Create the file name. */
-    strfmt(sp, "%s%s%s", dir, cmd, ext);
+/**
+ * This function reads up to limit bytes from the file descriptor provided
+ * into the ring. A single read is limited to a quarter of the ring, so the
+ * three quarters behind the head stay intact while it is in progress. It
+ * returns what read() returned.
+ */
+ssize_t ring_read(struct ring* r, int fd, size_t limit)
+{
+    uint64_t head;  /* The number of bytes written before this read. */
+    ssize_t n;      /* The number of bytes read. */
+
+    /* Read straight into the ring. The double mapping makes the space after
+     * the head contiguous even when it wraps around. */
+    head = atomic_load_explicit(&r->head, memory_order_relaxed);
+    if (limit > r->size / 4)
+        limit = r->size / 4;
+    if ((n = read(fd, r->base + (head & (r->size - 1)), limit)) > 0)
+        atomic_store_explicit(&r->head, head + n, memory_order_release);
+
+    return n;
 }
 
 /**
- * This function executes the command provided to it as a sub-process.
+ * This function copies up to size of the most recent bytes in the ring to buf
+ * and returns the number copied. It may run while the ring is being written
+ * to; bytes that were overwritten during the copy are left out.
  */
-void subproc_exec( subproc* sp, char* cmd, char* fdir )
+size_t ring_snapshot(struct ring* r, char* buf, size_t size)
 {
-    FILE* fout;         /* The file stream for stdout. */
-    FILE* ferr;         /* The file stream for stderr. */
-    char* tstamp;       /* A timestamp. */
-    char* fname_out;    /* The file name for the stdout file stream. */
-    char* fname_err;    /* The file name for the stderr file stream. */
-    
-    /* The file name extensions. */
-    char* fext_out = "_out.txt";
-    char* fext_err = "_err.txt";
+    uint64_t head;  /* The head when the copy started. */
+    uint64_t now;   /* The head when the copy finished. */
+    uint64_t start; /* Position of the first byte copied. */
+    uint64_t safe;  /* Position of the first byte that is still intact. */
+    size_t n;       /* The number of bytes copied. */
+
+    /* Copy the bytes behind the head. */
+    head = atomic_load_explicit(&r->head, memory_order_acquire);
+    n = (head < size) ? head : size;
+    if (n > r->size)
+        n = r->size;
+    start = head - n;
+    memcpy(buf, r->base + (start & (r->size - 1)), n);
 
-    /* Create a pipe to use for the child process. */
-    if (pipe((*sp)->fds) == -1)
+    /* Leave out the bytes a write may have reached while copying. */
+    atomic_thread_fence(memory_order_acquire);
+    now = atomic_load_explicit(&r->head, memory_order_relaxed);
+    safe = now + r->size / 4;
+    safe = (safe > r->size) ? safe - r->size : 0;
+    if (safe > start)
     {
-        /* There was an error creating the pipe so print it and exit the
+        if (safe >= head)
+            return 0;
+        memmove(buf, buf + (safe - start), head - safe);
+        n = head - safe;
+    }
+
+    return n;
+}
+
+/**
+ * This function makes the sub-process keep the most recent output of its
+ * stdout and stderr in ring buffers instead of writing it to files.
+ */
+void subproc_keeptail(subproc* sp, size_t size)
+{
+    /* Replace any previous rings. A snapshot leaves out the quarter of the
+     * ring that a read may be writing to, so the rings are made a third
+     * larger than asked for to keep size bytes out of its reach. */
+    ring_free((*sp)->out.tail);
+    ring_free((*sp)->err.tail);
+    (*sp)->out.tail = ring_init(size + (size + 2) / 3);
+    (*sp)->err.tail = ring_init(size + (size + 2) / 3);
+    (*sp)->out.keep = true;
+    (*sp)->err.keep = true;
+}
+
+/**
+ * This function copies up to size of the most recent bytes that the
+ * sub-process wrote to stdout or stderr into buf.
+ */
+size_t subproc_tail(subproc* sp, int stream, char* buf, size_t size)
+{
+    struct ring* r;     /* The ring of the stream. */
+
+    /* Take a snapshot of the stream's ring. */
+    r = (stream == STDERR_FILENO) ? (*sp)->err.tail : (*sp)->out.tail;
+    return (r != NULL) ? ring_snapshot(r, buf, size) : 0;
+}
+
+/**
+ * This function connects one of the sub-process's standard streams to the
+ * file descriptor provided the next time it is executed.
+ */
+void subproc_redirect(subproc* sp, int stream, int fd)
+{
+    /* Replace any redirection that was not used. */
+    if ((*sp)->redir[stream] != -1)
+        closefd((*sp)->redir[stream]);
+    (*sp)->redir[stream] = fd;
+}
+
+/**
+ * This function adds a file descriptor that output from the sub-process's
+ * stdout or stderr is passed on to.
+ */
+void subproc_stream(subproc* sp, int stream, int fd)
+{
+    struct capture* cap;    /* The stream. */
+
+    /* Find the stream. */
+    cap = (stream == STDERR_FILENO) ? &(*sp)->err : &(*sp)->out;
+    if (cap->nsinks == SUBPROC_MAX_SINKS)
+    {
+        /* There is no room for the sink so print an error and exit the
          * program. */
         fprintf(stderr,
-                "[ %s ] ERROR: In subproc_exec(): pipe() - %s\n", 
-                (tstamp = timestamp()), strerror(errno));
-        free(tstamp);
+                "[ %s ] ERROR: In subproc_stream(): more than %d sinks\n",
+                timestamp(), SUBPROC_MAX_SINKS);
         exit(EXIT_FAILURE);
     }
 
-    /* Create the child process. */
-    if (((*sp)->pid = fork()) == -1)
+    /* Add the sink. A sink whose reader goes away is dropped rather than
+     * killing the program. */
+    cap->sinks[cap->nsinks++] = fd;
+    ignore_sigpipe();
+}
+
+/**
+ * This function returns the output captured from a stream of the
+ * sub-process, storing its length at the pointer provided.
+ */
+const char* capture_get(struct capture* cap, size_t* len)
+{
+    /* Return the captured bytes, or an empty string if there are none. */
+    if (len != NULL)
+        *len = cap->len;
+    return (cap->data != NULL) ? cap->data : "";
+}
+
+/**
+ * This function returns the output captured from the sub-process's stdout.
+ */
+const char* subproc_out(subproc* sp, size_t* len)
+{
+    return capture_get(&(*sp)->out, len);
+}
+
+/**
+ * This function returns the output captured from the sub-process's stderr.
+ */
+const char* subproc_err(subproc* sp, size_t* len)
+{
+    return capture_get(&(*sp)->err, len);
+}
+
+/**
+ * This function creates a pipe whose file descriptors are closed on exec.
+ * If there is an error it is printed on stderr and the program exits.
+ */
+void mkpipe(int fds[2])
+{
+    /* Create the pipe. */
+    if (pipe2(fds, O_CLOEXEC) == -1)
     {
-        /* There was an error creating the child process so print it and
-         * exit the program. */
+        /* There was an error creating the pipe so print it and exit the
+         * program. */
         fprintf(stderr,
-                "ERROR: In subproc_exec() fork() - %s\n", 
-                (tstamp = timestamp()), strerror(errno));
-        free(tstamp);
+                "[ %s ] ERROR: In mkpipe(): pipe() - %s\n",
+                timestamp(), strerror(errno));
         exit(EXIT_FAILURE);
     }
-    else if ((*sp)->pid == 0)   /* The child process. */
+}
+
+/**
+ * This function creates the pipe that a stream is captured through. It
+ * returns the write end, which is to be given to the child.
+ */
+int capture_open(struct capture* cap)
+{
+    int fds[2];     /* The pipe's file descriptors. */
+
+    /* Create the pipe. The parent's end is non-blocking so draining it never
+     * stalls the evloop. */
+    mkpipe(fds);
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    cap->fd = fds[0];
+
+    /* Create the pipe that the stream is duplicated into if it goes to more
+     * than one place. */
+    if (cap->nsinks > 1 || (cap->nsinks == 1 && cap->keep))
+        mkpipe(cap->tmp);
+
+    /* Start with an empty buffer. */
+    cap->len = 0;
+    if (cap->data != NULL)
+        cap->data[0] = '\0';
+
+    return fds[1];
+}
+
+/**
+ * This function closes the pipes of a stream.
+ */
+void capture_close(struct capture* cap, evloop* ev)
+{
+    /* Close the stream's pipe. */
+    if (cap->fd != -1)
     {
-        /* Print status message. */
-        fprintf(stdout,
-                "[ %s ] Creating sub-process...\n", 
-                (tstamp = timestamp()));
-        free(tstamp);
-
-        /* Create the file names for the output information. */
-        mkfname(&fname_out, fdir, cmd, fext_out);
-        mkfname(&fname_err, fdir, cmd, fext_err);
-
-        /* Set the read descriptor of the child process to be
-         * stdin's descriptor. */
-        duperr(((*sp)->fds )[0], STDIN_FILENO);
-
-        /* Open the file streams. */
-        fout = openfs(fname_out, "w");
-        ferr = openfs(fname_err, "w");
-
-        /* Setting the descriptor of the output file's stream to be
-         * stdout's descriptor. */
-        duperr(fileno(fout), STDOUT_FILENO);
-
-        /* Set the descriptor of the error file's stream to be
-         * stderr's descriptor. */
-        duperr(fileno(ferr), STDERR_FILENO);
-
-        /* Now that the descriptors have been set, close the file streams
-         * and free the memory allocated to the file names. */
-        closefs(fout);
-        closefs(ferr);
-        free(fname_out);
-        free(fname_err);
-
-        /* Print a status message. */
-        fprintf(stdout, 
-                "[ %s ] Sub-process created... Executing command...\n",
-                (tstamp = timestamp()));
-        free(tstamp);
+        if (ev != NULL)
+            evloop_delfd(ev, cap->fd);
+        closefd(cap->fd);
+        cap->fd = -1;
+    }
 
-        /* Execute the command as the child process. */
-        execl("/bin/sh", "sh", "-c", cmd, NULL);
-        
-        /* There was an error executing the command so we are print it. */
-        fprintf(stderr, 
-                "[ %s ] execl failed with error - %s", 
-                (tstamp = timestamp()), strerror( errno ));
-        free(tstamp);
+    /* Close the pipe it was duplicated into. */
+    if (cap->tmp[0] != -1)
+    {
+        closefd(cap->tmp[0]);
+        closefd(cap->tmp[1]);
+        cap->tmp[0] = cap->tmp[1] = -1;
     }
 }
 
 /**
- * This function requests for the provided sub-process to be terminated, waits
- * for it to exit, and reports its exit-status to stdout or stderr if there
- * was an error.
+ * This function reads up to limit bytes from a stream's pipe into its buffer,
+ * or into its ring if it has one.
+ * Bytes beyond the stream's limit are read and discarded so the child never
+ * blocks. It returns what read() returned.
  */
-void subproc_term( subproc* sp )
+ssize_t capture_read(struct capture* cap, size_t limit)
 {
-    int status;     /* The exit status of the process. */
-    char* tstamp;   /* A time stamp. */
-
-    /* Print a status message. */
-    fprintf(stdout, 
-            "[ %s ] Terminating sub-process...\n", 
-            (tstamp = timestamp()));
-    free(tstamp);
+    char scratch[4096];     /* Space for bytes that are being discarded. */
+    char* dst;              /* Where to read to. */
+    size_t room;            /* How much can be read. */
+    size_t size;            /* The new size of the buffer. */
+    ssize_t n;              /* The number of bytes read. */
 
-    /* Terminate the process. */
-    kill( ( *sp )->pid, SIGTERM);
+    /* Streams with a ring keep only their most recent bytes. */
+    if (cap->tail != NULL)
+        return ring_read(cap->tail, cap->fd, limit);
 
-    /* Wait for the process to exit and then print its exit status. */
-    do
+    /* Make room in the buffer, unless it is at its limit or the stream is
+     * not kept, which happens when every sink it was passed on to failed. */
+    if (cap->keep && (cap->max == 0 || cap->len < cap->max))
     {
-        if (((*sp)->pid = waitpid((*sp)->pid, &status, WNOHANG)) == -1)
-        {
-            /* There was an error waiting for the process to exit so print
-             * the error. */
-            fprintf(stderr, 
-                    "[ %s ] ERROR: in subproc_term(): wait() error!\n",
-                    (tstamp = timestamp()));
-            free(tstamp);
-        }
-        else if ((*sp)->pid == 0)
+        if (cap->size - cap->len < 2)
         {
-            /* The process is still running so print a status message and wait
-             * for one second. */
-            fprintf(stdout,
-                    "[ %s ] Waiting for process to terminate...\n",
-                    (tstamp = timestamp()));
-            free(tstamp);
-            sleep (1);
+            size = (cap->size > 0) ? cap->size * 2 : 4096;
+            if (cap->max > 0 && size > cap->max + 1)
+                size = cap->max + 1;
+            cap->data = (char*) realloc(cap->data, size);
+            cap->size = size;
         }
-        else
+        dst = cap->data + cap->len;
+        room = cap->size - cap->len - 1;
+        if (cap->max > 0 && room > cap->max - cap->len)
+            room = cap->max - cap->len;
+    }
+    else
+    {
+        dst = scratch;
+        room = sizeof(scratch);
+    }
+
+    /* Read from the pipe. */
+    if ((n = read(cap->fd, dst, (room < limit) ? room : limit)) > 0 &&
+        dst != scratch)
+    {
+        cap->len += n;
+        cap->data[cap->len] = '\0';
+    }
+
+    return n;
+}
+
+/**
+ * This function writes n bytes from the buffer provided to a sink, waiting
+ * for room if it is full. It returns false, with errno set, if the sink
+ * fails.
+ */
+bool sink_write(int fd, const void* buf, size_t n)
+{
+    ssize_t done;   /* The number of bytes written by write(). */
+
+    /* Writing until every byte is out. */
+    while (n > 0)
+    {
+        if ((done = write(fd, buf, n)) == -1)
         {
-            /* There is no longer a process with the pid so look at what
-             * happened to it. */
-            if (WIFEXITED(status))
-            {
-                /* The process exited normally so print its exit status. */
-                fprintf(stdout,
-                        "[ %s ] The process exited normally with exit"
-                        " status %d.\n", 
-                        (tstamp = timestamp()), WEXITSTATUS(status));
-                free(tstamp);
-            }
-            else if (WIFSIGNALED(status))
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN)
             {
-                /* The process exited because of an uncaught signal. */
-                fprintf(stdout, 
-                        "[ %s ] The process did not exit normally\n",
-                        (tstamp = timestamp()));
-                free(tstamp);
+                waitwritable(fd);
+                continue;
             }
-            else
+            return false;
+        }
+        buf = (const char*) buf + done;
+        n -= (size_t) done;
+    }
+
+    return true;
+}
+
+/**
+ * This function moves n bytes that are waiting in a pipe to the file
+ * descriptor provided, with splice() so they are not copied through the
+ * parent. Sinks that splice() does not support, such as files opened with
+ * O_APPEND, are written to instead, and a non-blocking sink that is full is
+ * waited for. If the sink fails the rest of the bytes are read and discarded,
+ * so they are consumed either way, and false is returned with errno set.
+ */
+bool pipe_to(int pipefd, int fd, size_t n)
+{
+    char buf[4096];     /* Space for bytes that cannot be spliced. */
+    ssize_t moved;      /* The number of bytes moved. */
+    int err;            /* Why the sink failed. */
+
+    while (n > 0)
+    {
+        /* Move the bytes without copying them, if the sink allows it. */
+        if ((moved = splice(pipefd, NULL, fd, NULL, n, SPLICE_F_MOVE)) == -1 &&
+            errno == EINVAL)
+        {
+            /* Copy the bytes through a buffer instead. */
+            if ((moved = read(pipefd, buf, (n < sizeof(buf)) ? n : sizeof(buf)))
+                > 0 && !sink_write(fd, buf, (size_t) moved))
             {
-                /* The process did not exit. */
-                fprintf(stdout, 
-                        "[ %s ] The child process did not exit\n",
-                        (tstamp = timestamp()));
-                free(tstamp);
+                n -= moved;
+                break;
             }
         }
-    } while ((*sp)->pid == 0);
+
+        /* The bytes are known to be waiting, so EAGAIN means the sink is
+         * full. Wait for room rather than losing them. */
+        if (moved == -1 && errno == EAGAIN)
+        {
+            waitwritable(fd);
+            continue;
+        }
+        if (moved == -1 && errno == EINTR)
+            continue;
+        if (moved <= 0)
+            break;
+        n -= moved;
+    }
+    if (n == 0)
+        return true;
+
+    /* The sink failed, so discard what it did not take. */
+    err = errno;
+    while (n > 0 &&
+           ((moved = read(pipefd, buf, (n < sizeof(buf)) ? n : sizeof(buf)))
+            > 0 || (moved == -1 && errno == EINTR)))
+        if (moved > 0)
+            n -= moved;
+    errno = err;
+
+    return false;
+}
+
+/**
+ * This function stops passing a stream on to the sink at index i, after
+ * printing why on stderr, so that one failed sink, such as a socket whose
+ * reader has gone, does not stop the stream reaching the others.
+ */
+void capture_dropsink(struct capture* cap, size_t i)
+{
+    /* Print the error, which is not fatal. */
+    fprintf(stderr,
+            "[ %s ] ERROR: In capture_dropsink(): sink %d - %s, "
+            "dropping it\n",
+            timestamp(), cap->sinks[i], strerror(errno));
+
+    /* Remove the sink, keeping the others in order. */
+    memmove(&cap->sinks[i], &cap->sinks[i + 1],
+            (cap->nsinks - i - 1) * sizeof(int));
+    cap->nsinks--;
 }
 
+/**
+ * This function splices the bytes waiting in a stream's pipe to its only sink.
+ * It returns the number of bytes consumed, 0 at the end of the stream, or -1
+ * with errno set. If the sink fails it is dropped and -1 is returned with
+ * errno set to EINTR, so the caller tries again.
+ */
+ssize_t capture_splice(struct capture* cap)
+{
+    ssize_t n;      /* The number of bytes passed on. */
+    int err;        /* Why splice() failed. */
+    int avail;      /* The number of bytes waiting in the pipe. */
+    char c;         /* A byte read to find the end of the stream. */
+
+    /* Move the bytes straight to the sink, if it allows it. */
+    if ((n = splice(cap->fd, NULL, cap->sinks[0], NULL, 1 << 16,
+                    SPLICE_F_MOVE | SPLICE_F_NONBLOCK)) != -1 ||
+        (err = errno) == EINTR)
+        return n;
+    if (err != EINVAL && err != EAGAIN)
+    {
+        capture_dropsink(cap, 0);
+        errno = EINTR;
+        return -1;
+    }
+
+    /* The sink does not support splice(), or it is full, so pass on what is
+     * waiting through pipe_to(), which copies the bytes or waits for room as
+     * needed. Otherwise the pipe would stay readable and the evloop would
+     * spin on it. */
+    if (ioctl(cap->fd, FIONREAD, &avail) == 0 && avail > 0)
+    {
+        if (!pipe_to(cap->fd, cap->sinks[0], (size_t) avail))
+            capture_dropsink(cap, 0);
+        return avail;
+    }
+
+    /* Nothing is waiting. splice() reports the end of the stream itself, so
+     * EAGAIN means the pipe is just empty. Otherwise reading tells the end of
+     * the stream apart from an empty pipe, and passes on a byte that arrived
+     * in the meantime. */
+    if (err == EAGAIN)
+    {
+        errno = EAGAIN;
+        return -1;
+    }
+    if ((n = read(cap->fd, &c, 1)) == 1 && !sink_write(cap->sinks[0], &c, 1))
+        capture_dropsink(cap, 0);
+    return n;
+}
+
+/**
+ * This function passes the bytes waiting in a stream's pipe on to each of its
+ * sinks. The bytes are duplicated with tee() for every sink but the one that
+ * consumes them, so they never pass through the parent's memory unless the
+ * stream is also kept. Sinks that fail are dropped. It returns the number of
+ * bytes consumed, 0 at the end of the stream, or -1 with errno set.
+ */
+ssize_t capture_tee(struct capture* cap)
+{
+    size_t nteed;   /* The number of sinks fed through tee(). */
+    ssize_t n;      /* The number of bytes being passed on. */
+    ssize_t done;   /* The number of bytes consumed. */
+    ssize_t got;    /* The number of bytes read. */
+    size_t i;       /* Index of the current sink. */
+
+    /* Without a sink fed through tee() the bytes are spliced straight to
+     * the only sink. */
+    nteed = cap->keep ? cap->nsinks : cap->nsinks - 1;
+    if (nteed == 0)
+        return capture_splice(cap);
+
+    /* Duplicate the waiting bytes to each sink fed through tee(). tee() always
+     * starts from the front of the pipe, so each sink gets the same bytes. A
+     * sink that fails is dropped, which moves the next one to its index. */
+    for (i = 0, n = 1 << 16; i < nteed;)
+    {
+        if ((n = tee(cap->fd, cap->tmp[1], n, SPLICE_F_NONBLOCK)) <= 0)
+            return n;
+        if (pipe_to(cap->tmp[0], cap->sinks[i], n))
+            i++;
+        else
+        {
+            capture_dropsink(cap, i);
+            nteed--;
+        }
+    }
 
+    /* Consume the bytes, either into the last sink or into memory. They are
+     * known to be waiting, but if a read comes up short what was consumed is
+     * returned rather than waiting for the rest. */
+    if (!cap->keep)
+    {
+        if (!pipe_to(cap->fd, cap->sinks[nteed], n))
+            capture_dropsink(cap, nteed);
+        return n;
+    }
+    for (done = 0; done < n;)
+    {
+        if ((got = capture_read(cap, n - done)) > 0)
+            done += got;
+        else if (got == 0 || errno != EINTR)
+            break;
+    }
+    return (done > 0) ? done : got;
+}
+
+/**
+ * This function reads whatever is waiting in a stream's pipe, keeping it in
+ * memory and/or passing it on to the stream's sinks. When the end of the
+ * stream is reached its pipes are closed.
+ */
+void capture_drain(struct capture* cap, evloop* ev)
+{
+    ssize_t n;      /* The number of bytes handled. */
+
+    while (cap->fd != -1)
+    {
+        /* Handle the waiting bytes. */
+        n = (cap->nsinks == 0) ? capture_read(cap, SIZE_MAX)
+                               : capture_tee(cap);
+
+        /* Close the pipes at the end of the stream. */
+        if (n == 0)
+            capture_close(cap, ev);
+        else if (n == -1 && errno != EINTR)
+            return;
+    }
+}
+
+/**
+ * This function is called by the evloop when a captured stream's pipe
+ * becomes readable.
+ */
+void on_capture(evloop* ev, int fd, uint32_t events, void* arg)
+{
+    subproc sp = (subproc) arg;     /* The sub-process that wrote. */
+
+    /* Drain the stream that became readable. */
+    capture_drain((sp->out.fd == fd) ? &sp->out : &sp->err, ev);
+}
+
+/**
+ * This function ignores SIGPIPE unless the program handles it. Writing to a
+ * pipe or socket whose reader has gone, such as a child's stdin or a sink,
+ * raises SIGPIPE, which would kill the program; ignored, the write fails with
+ * EPIPE instead.
+ */
+void ignore_sigpipe()
+{
+    struct sigaction old;   /* The SIGPIPE handler in place. */
+
+    /* Ignoring the signal if nothing else handles it. */
+    if (!sigpipe_ignored && sigaction(SIGPIPE, NULL, &old) == 0 &&
+        old.sa_handler == SIG_DFL && !(old.sa_flags & SA_SIGINFO))
+    {
+        signal(SIGPIPE, SIG_IGN);
+        sigpipe_ignored = true;
+    }
+}
+
+/**
+ * This function gives the sub-process a pipe as its stdin from the next time
+ * it is executed.
+ */
+void subproc_stdin(subproc* sp, size_t max, subproc_feedfn fn, void* arg)
+{
+    (*sp)->in.enabled = true;
+    (*sp)->in.max = (max > 0) ? max : 65536;
+    (*sp)->in.fn = fn;
+    (*sp)->in.arg = arg;
+
+    /* The child may close its stdin before it has all been written. */
+    ignore_sigpipe();
+}
+
+/**
+ * This function closes the stdin pipe of a sub-process and empties its
+ * queue.
+ */
+void feed_close(subproc* sp)
+{
+    struct feed* in = &(*sp)->in;   /* The stdin of the process. */
+    struct chunk* c;                /* The current piece of input. */
+
+    /* Close the pipe, which gives the child EOF. */
+    if (in->fd != -1)
+    {
+        if ((*sp)->ev != NULL)
+            evloop_delfd((*sp)->ev, in->fd);
+        closefd(in->fd);
+        in->fd = -1;
+    }
+
+    /* Throw away anything that was not written. */
+    while ((c = in->head) != NULL)
+    {
+        in->head = c->next;
+        free(c);
+    }
+    in->tail = NULL;
+    in->queued = 0;
+    in->closing = false;
+    in->armed = false;
+}
+
+/**
+ * This function writes as much of the queued input to the sub-process's stdin
+ * as the pipe takes without blocking, closing it if it was asked to be once
+ * the queue is empty. It returns true if the queue is empty.
+ */
+bool feed_flush(subproc* sp)
+{
+    struct feed* in = &(*sp)->in;   /* The stdin of the process. */
+    struct chunk* c;                /* The current piece of input. */
+    ssize_t done;                   /* The number of bytes written. */
+
+    while ((c = in->head) != NULL)
+    {
+        /* Write the bytes, or move them from the file without copying
+         * them. */
+        if (c->src == -1)
+            done = write(in->fd, c->data + c->off, c->len);
+        else
+            done = splice(c->src, NULL, in->fd, NULL,
+                          (c->len < (1 << 20)) ? c->len : (1 << 20),
+                          SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if (done == -1)
+        {
+            /* Wait for the pipe to have room. */
+            if (errno == EAGAIN)
+                return false;
+            if (errno == EINTR)
+                continue;
+
+            /* The child has stopped reading, or the file could not be
+             * read, so there is no point writing anything else. */
+            feed_close(sp);
+            return true;
+        }
+
+        /* Move past what was written. A file that has ended is done. */
+        if (c->src == -1)
+        {
+            c->off += (size_t) done;
+            in->queued -= (size_t) done;
+        }
+        c->len = (done == 0) ? 0 : c->len - (size_t) done;
+        if (c->len == 0)
+        {
+            if ((in->head = c->next) == NULL)
+                in->tail = NULL;
+            free(c);
+        }
+    }
+
+    /* Everything has been written. */
+    if (in->closing)
+        feed_close(sp);
+    return true;
+}
+
+/**
+ * This function makes the evloop wait for the sub-process's stdin to have
+ * room if there is input waiting, or for the producer to be called.
+ */
+void feed_arm(subproc* sp, bool on)
+{
+    struct feed* in = &(*sp)->in;   /* The stdin of the process. */
+
+    if ((*sp)->ev == NULL || in->fd == -1 || in->armed == on)
+        return;
+    evloop_modfd((*sp)->ev, in->fd, on ? EPOLLOUT : 0);
+    in->armed = on;
+}
+
+/**
+ * This function writes the queued input to the sub-process's stdin, and asks
+ * the producer for more whenever the queue empties.
+ */
+void feed_run(subproc* sp)
+{
+    struct feed* in = &(*sp)->in;   /* The stdin of the process. */
+
+    /* The producer may queue input itself, which ends up back here. */
+    if (in->feeding)
+        return;
+
+    while (in->fd != -1)
+    {
+        /* If the pipe is full, write the rest when it has room. */
+        if (!feed_flush(sp))
+        {
+            feed_arm(sp, true);
+            return;
+        }
+
+        /* The queue is empty, so ask the producer for more. Without a
+         * producer, or if it offers nothing, wait until something is
+         * queued. */
+        if (in->fd == -1)
+            return;
+        in->fed = false;
+        if (in->fn != NULL)
+        {
+            in->feeding = true;
+            in->fn(&(*sp)->self, in->arg);
+            in->feeding = false;
+        }
+        if (!in->fed)
+        {
+            feed_arm(sp, false);
+            return;
+        }
+    }
+}
+/**
+ * This function is called by the evloop when the sub-process's stdin has
+ * room.
+ */
+void on_stdin(evloop* ev, int fd, uint32_t events, void* arg)
+{
+    subproc sp = (subproc) arg;     /* The sub-process being written to. */
+
+    /* The child has closed its end, so nothing more can be written. */
+    if (events & (EPOLLERR | EPOLLHUP))
+    {
+        feed_close(&sp);
+        return;
+    }
+
+    feed_run(&sp);
+}
+
+/**
+ * This function adds a piece of input to the end of the queue.
+ */
+void feed_push(subproc* sp, struct chunk* c)
+{
+    struct feed* in = &(*sp)->in;   /* The stdin of the process. */
+
+    c->next = NULL;
+    if (in->tail != NULL)
+        in->tail->next = c;
+    else
+        in->head = c;
+    in->tail = c;
+}
+
+/**
+ * This function queues n bytes from buf to be written to the sub-process's
+ * stdin.
+ */
+size_t subproc_write(subproc* sp, const void* buf, size_t n)
+{
+    struct feed* in = &(*sp)->in;   /* The stdin of the process. */
+    struct chunk* c;                /* The piece of input. */
+    ssize_t done;                   /* The number of bytes written. */
+    size_t room;                    /* The room left in the queue. */
+
+    /* Input cannot be written once stdin is closed. */
+    if (in->fd == -1 || in->closing)
+        return 0;
+    in->fed = true;
+
+    /* Write straight to the pipe if nothing is waiting ahead of it. */
+    done = 0;
+    if (in->head == NULL &&
+        (done = write(in->fd, buf, n)) == -1)
+    {
+        if (errno != EAGAIN && errno != EINTR)
+        {
+            feed_close(sp);
+            return 0;
+        }
+        done = 0;
+    }
+    if ((size_t) done == n)
+        return n;
+
+    /* Queue as much of the rest as there is room for. */
+    room = (in->queued < in->max) ? in->max - in->queued : 0;
+    if ((n -= (size_t) done) > room)
+        n = room;
+    if (n > 0)
+    {
+        c = (struct chunk*) malloc(sizeof(struct chunk) + n);
+        c->src = -1;
+        c->len = n;
+        c->off = 0;
+        memcpy(c->data, (const char*) buf + done, n);
+        feed_push(sp, c);
+        in->queued += n;
+    }
+
+    /* Write it when the pipe has room. */
+    if (!in->feeding)
+        feed_arm(sp, true);
+
+    return (size_t) done + n;
+}
+
+/**
+ * This function queues part of a file to be written to the sub-process's
+ * stdin.
+ */
+void subproc_sendfile(subproc* sp, int fd, size_t len)
+{
+    struct chunk* c;    /* The piece of input. */
+
+    /* Input cannot be written once stdin is closed. */
+    if ((*sp)->in.fd == -1 || (*sp)->in.closing)
+        return;
+    (*sp)->in.fed = true;
+
+    /* Queue the file. */
+    c = (struct chunk*) malloc(sizeof(struct chunk));
+    c->src = fd;
+    c->len = (len > 0) ? len : SIZE_MAX;
+    c->off = 0;
+    feed_push(sp, c);
+
+    /* Write it when the pipe has room. */
+    if (!(*sp)->in.feeding)
+        feed_arm(sp, true);
+}
+
+/**
+ * This function closes the sub-process's stdin once everything queued has
+ * been written.
+ */
+void subproc_closein(subproc* sp)
+{
+    /* Nothing to do if it is closed. */
+    if ((*sp)->in.fd == -1)
+        return;
+
+    /* Close it now if nothing is waiting, or once the rest is written. */
+    (*sp)->in.fed = true;
+    (*sp)->in.closing = true;
+    if ((*sp)->in.head == NULL)
+        feed_close(sp);
+    else if (!(*sp)->in.feeding)
+        feed_arm(sp, true);
+}
+
+/**
+ * This function returns the number of bytes from subproc_write() that are
+ * waiting to be written to the sub-process's stdin.
+ */
+size_t subproc_queued(subproc* sp)
+{
+    return (*sp)->in.queued;
+}
+
+/**
+ * This function adds a dup2() of the "old" file descriptor provided to it to
+ * the spawn file actions provided to it. If there is an error it is printed on
+ * stderr and the program exits.
+ *
+ * The dup2() is carried out by the child just before it executes its command,
+ * and is used to specify the file descriptor being used for a pipe(),
+ * file, etc...
+ */
+void duperr(posix_spawn_file_actions_t* fa, int fdold, int fdnew)
+{
+    int err;        /* The error number. */
+
+    /* Attempting to add the duplication of the file descriptor. */
+    if ((err = posix_spawn_file_actions_adddup2(fa, fdold, fdnew)) != 0)
+    {
+        /* There was an error adding the duplication so print it and
+         * exit the program. */
+        fprintf(stderr,
+                "[ %s ] dup2 failed on fileno() %s\n",
+                timestamp(), strerror(err));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * This function creates a file name from a directory path, a shell command,
+ * the number of the launch and a file extension. The number, if it is not 0,
+ * keeps the files of two launches of the same command apart. The file name is
+ * allocated from the arena provided.
+ */
+char* mkfname(arena* a, char* dir, char* cmd, unsigned long seq, char* ext)
+{
+    char* cmd_cpy;  /* A copy of the command. */
+
+    /* Copy the command so the caller's string is left untouched. */
+    cmd_cpy = astrfmt(a, "%s", cmd);
+
+    /* Remove unwanted characters from the copy. */
+    sdelchars(cmd_cpy, "/.");
+
+    /* Create the file name. */
+    if (seq == 0)
+        return astrfmt(a, "%s%s%s", dir, cmd_cpy, ext);
+    return astrfmt(a, "%s%s_%lu%s", dir, cmd_cpy, seq, ext);
+}
+
+/**
+ * This function returns a pidfd for the process id provided to it, or -1 if
+ * the kernel does not support them.
+ */
+int pidfd(pid_t pid)
+{
+#ifdef SYS_pidfd_open
+    /* Open the pidfd. */
+    return (int) syscall(SYS_pidfd_open, pid, 0);
+#else
+    /* pidfds are not available. */
+    return -1;
+#endif
+}
+
+/**
+ * This function sends a signal to the sub-process, through its pidfd if it
+ * has one. It returns -1 on error, as kill() does.
+ */
+int sigsend(subproc* sp, int sig)
+{
+#ifdef SYS_pidfd_send_signal
+    /* Signal the process through its pidfd. */
+    if ((*sp)->pidfd != -1)
+        return (int) syscall(SYS_pidfd_send_signal, (*sp)->pidfd, sig,
+                                                   NULL, 0);
+#endif
+    /* Signal the process through its pid. */
+    return kill((*sp)->pid, sig);
+}
+
+/**
+ * This function writes a value, formatted from the format string and argument
+ * list, to the file of the cgroup directory dirfd named by the string
+ * provided. It returns false if the file could not be written.
+ */
+bool cgroup_write(int dirfd, char* file, char* fmt, ...)
+{
+    char buf[64];   /* The value. */
+    va_list lp;     /* Pointer to the list of arguments. */
+    int len;        /* The length of the value. */
+    int fd;         /* The file. */
+    bool ok;        /* Whether the value was written. */
+
+    /* Format the value. */
+    va_start(lp, fmt);
+    len = vsnprintf(buf, sizeof(buf), fmt, lp);
+    va_end(lp);
+
+    /* Write it with one write(), as the kernel expects. */
+    if ((fd = openat(dirfd, file, O_WRONLY | O_CLOEXEC)) == -1)
+        return false;
+    ok = (write(fd, buf, (size_t) len) == len);
+    close(fd);
+
+    return ok;
+}
+
+/**
+ * This function closes the files of a cgroup and removes it.
+ */
+void cgroup_remove(struct cgroup* cg)
+{
+    /* Nothing to do without a cgroup. */
+    if (cg->fd == -1)
+        return;
+
+    /* Close its files. */
+    if (cg->cpustat != -1)
+        closefd(cg->cpustat);
+    if (cg->memcur != -1)
+        closefd(cg->memcur);
+    if (cg->mempeak != -1)
+        closefd(cg->mempeak);
+    closefd(cg->fd);
+
+    /* Remove it. This fails, leaving it behind, if it still has
+     * processes. */
+    rmdir(cg->path);
+    free(cg->path);
+    cg->fd = -1;
+    cg->path = NULL;
+    cg->cpustat = cg->memcur = cg->mempeak = -1;
+}
+
+/**
+ * This function places the sub-process in a cgroup of its own, created under
+ * the cgroup directory parent, from the next time it is executed.
+ */
+bool subproc_setcgroup(subproc* sp, char* parent,
+                                    const subproc_limits* limits)
+{
+    static unsigned long n = 0; /* The number of cgroups created. */
+    struct cgroup* cg;          /* The cgroup. */
+    int pfd;                    /* The parent cgroup's directory. */
+    bool ok;                    /* Whether the limits were set. */
+
+    /* Replace any cgroup the sub-process already has. */
+    cg = &(*sp)->cg;
+    cgroup_remove(cg);
+
+    /* Create the cgroup. Without delegation this fails with EACCES, EROFS
+     * or ENOENT, and the sub-process goes without one. */
+    strfmt(&cg->path, "%s/subproc-%d-%lu", parent, (int) getpid(), n++);
+    if (mkdir(cg->path, 0755) == -1 ||
+        (cg->fd = open(cg->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) == -1)
+    {
+        rmdir(cg->path);
+        free(cg->path);
+        cg->path = NULL;
+        return false;
+    }
+
+    /* Apply the limits, enabling their controllers for the parent's
+     * children first. That may already be done, or not be allowed, so only
+     * the limits themselves are checked. */
+    ok = true;
+    if (limits != NULL)
+    {
+        if ((pfd = open(parent, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) != -1)
+        {
+            if (limits->cpu_quota > 0)
+                cgroup_write(pfd, "cgroup.subtree_control", "+cpu");
+            if (limits->memory_max > 0)
+                cgroup_write(pfd, "cgroup.subtree_control", "+memory");
+            if (limits->pids_max > 0)
+                cgroup_write(pfd, "cgroup.subtree_control", "+pids");
+            closefd(pfd);
+        }
+        if (ok && limits->cpu_quota > 0)
+            ok = cgroup_write(cg->fd, "cpu.max", "%llu %llu",
+                        (unsigned long long) limits->cpu_quota,
+                        (unsigned long long) ((limits->cpu_period > 0) ?
+                                              limits->cpu_period : 100000));
+        if (ok && limits->memory_max > 0)
+            ok = cgroup_write(cg->fd, "memory.max", "%llu",
+                              (unsigned long long) limits->memory_max);
+        if (ok && limits->pids_max > 0)
+            ok = cgroup_write(cg->fd, "pids.max", "%llu",
+                              (unsigned long long) limits->pids_max);
+    }
+    if (!ok)
+    {
+        cgroup_remove(cg);
+        return false;
+    }
+
+    /* Keep the counters open so reading them is only a pread(). Those of
+     * controllers that are not enabled are missing. */
+    cg->cpustat = openat(cg->fd, "cpu.stat", O_RDONLY | O_CLOEXEC);
+    cg->memcur = openat(cg->fd, "memory.current", O_RDONLY | O_CLOEXEC);
+    cg->mempeak = openat(cg->fd, "memory.peak", O_RDONLY | O_CLOEXEC);
+
+    return true;
+}
+
+/**
+ * This function reads the counter file provided to it into buf, which it
+ * null-terminates, and returns the number of bytes read.
+ */
+size_t counter_read(int fd, char* buf, size_t size)
+{
+    ssize_t len;    /* The number of bytes read. */
+
+    /* A counter is read from the start each time. */
+    if (fd == -1 || (len = pread(fd, buf, size - 1, 0)) < 0)
+        len = 0;
+    buf[len] = '\0';
+
+    return (size_t) len;
+}
+
+/**
+ * This function stores the resource usage of the sub-process's cgroup at st.
+ */
+bool subproc_cgread(subproc* sp, subproc_cgstats* st)
+{
+    struct cgroup* cg = &(*sp)->cg; /* The cgroup. */
+    char buf[512];                  /* The contents of a counter file. */
+    char* line;                     /* The current line of cpu.stat. */
+
+    /* Nothing to read without a cgroup. */
+    if (cg->fd == -1)
+        return false;
+    memset(st, 0, sizeof(subproc_cgstats));
+
+    /* Pick out the CPU times, which are on the first lines of cpu.stat. */
+    counter_read(cg->cpustat, buf, sizeof(buf));
+    for (line = buf; *line != '\0'; line = strchrnul(line, '\n'))
+    {
+        if (*line == '\n')
+            line++;
+        if (strncmp(line, "usage_usec ", 11) == 0)
+            st->usage_usec = strtoull(line + 11, NULL, 10);
+        else if (strncmp(line, "user_usec ", 10) == 0)
+            st->user_usec = strtoull(line + 10, NULL, 10);
+        else if (strncmp(line, "system_usec ", 12) == 0)
+            st->system_usec = strtoull(line + 12, NULL, 10);
+    }
+
+    /* Read the memory counters. */
+    counter_read(cg->memcur, buf, sizeof(buf));
+    st->memory_current = strtoull(buf, NULL, 10);
+    counter_read(cg->mempeak, buf, sizeof(buf));
+    st->memory_peak = strtoull(buf, NULL, 10);
+
+    return true;
+}
+
+/**
+ * This function starts the program at the path provided to it directly inside
+ * the sub-process's cgroup with clone3(). The child only duplicates its
+ * descriptors, changes directory and executes the program; the parent waits
+ * until it has done so. It returns false if clone3() could not be used.
+ */
+bool spawn_cgroup(subproc* sp, char* path, char* const argv[],
+                  char* const envp[], int fd_in, int fd_out, int fd_err)
+{
+#ifdef SYS_clone3
+    struct clone3_args args;    /* The arguments of clone3(). */
+    sigset_t mask;              /* The child's signal mask. */
+    int pfd;                    /* The pidfd of the child. */
+    long pid;                   /* The process id of the child. */
+
+    /* Give up if the kernel has no clone3(). */
+    if (!clone3_ok)
+        return false;
+
+    /* SIGCHLD may be blocked for the signalfd, which the child must not
+     * inherit. */
+    if (sigchld.fd != -1)
+    {
+        pthread_sigmask(SIG_SETMASK, NULL, &mask);
+        sigdelset(&mask, SIGCHLD);
+    }
+
+    /* Start the child in the cgroup, with a pidfd. The parent is suspended
+     * until the child has executed the program, as with posix_spawn().
+     * Without CLONE_VM the child gets a copy of the parent's page tables,
+     * so this path costs as much as fork() for a large parent; sharing the
+     * memory would need a stack of its own for the child, as posix_spawn()
+     * sets up. */
+    memset(&args, 0, sizeof(args));
+    args.flags = CLONE_VFORK | CLONE_PIDFD | CLONE_INTO_CGROUP;
+    args.pidfd = (uint64_t) (uintptr_t) &pfd;
+    args.exit_signal = SIGCHLD;
+    args.cgroup = (uint64_t) (*sp)->cg.fd;
+    if ((pid = syscall(SYS_clone3, &args, sizeof(args))) == 0)
+    {
+        /* This is the child. Only async-signal-safe calls are made. */
+        if (dup2(fd_in, STDIN_FILENO) == -1 ||
+            dup2(fd_out, STDOUT_FILENO) == -1 ||
+            dup2(fd_err, STDERR_FILENO) == -1 ||
+            ((*sp)->cwd != NULL && chdir((*sp)->cwd) == -1))
+            _exit(127);
+        if (((*sp)->group == SUBPROC_PGROUP && setpgid(0, 0) == -1) ||
+            ((*sp)->group == SUBPROC_SESSION && setsid() == -1))
+            _exit(127);
+        if (sigpipe_ignored)
+            signal(SIGPIPE, SIG_DFL);
+        if (sigchld.fd != -1)
+            sigprocmask(SIG_SETMASK, &mask, NULL);
+        execve(path, argv, envp);
+        _exit(127);
+    }
+
+    /* Fall back to posix_spawn() if clone3() failed, and stop trying it if
+     * the kernel does not have it. */
+    if (pid == -1)
+    {
+        if (errno == ENOSYS)
+            clone3_ok = false;
+        return false;
+    }
+
+    /* The child is running. */
+    (*sp)->pid = (pid_t) pid;
+    (*sp)->pidfd = pfd;
+    (*sp)->running = true;
+
+    return true;
+#else
+    /* clone3() is not available. */
+    return false;
+#endif
+}
+
+/**
+ * This function launches the program at the path provided to it as a
+ * sub-process. Its stdin, stdout and stderr are connected to the file
+ * descriptors provided to this function.
+ */
+void spawn(subproc* sp, char* path, char* const argv[], char* const envp[],
+                                        int fd_in, int fd_out, int fd_err)
+{
+    posix_spawn_file_actions_t fa;  /* What the child does before exec. */
+    posix_spawnattr_t attr;         /* How the child is created. */
+    sigset_t mask;                  /* The child's signal mask, then the
+                                       signals it gets the default action
+                                       for. */
+    short flags;                    /* The spawn attributes that are set. */
+    int err;                        /* The error number. */
+
+    /* The child leads its own group if it is started in one. */
+    (*sp)->leader = ((*sp)->group != SUBPROC_INHERIT);
+    (*sp)->suspended = false;
+    (*sp)->terminating = false;
+
+    /* Start the child straight inside its cgroup if it has one. */
+    if ((*sp)->cg.fd != -1 &&
+        spawn_cgroup(sp, path, argv, envp, fd_in, fd_out, fd_err))
+        return;
+
+    /* Set up the actions the child will carry out before executing. */
+    posix_spawn_file_actions_init(&fa);
+    duperr(&fa, fd_in, STDIN_FILENO);
+    duperr(&fa, fd_out, STDOUT_FILENO);
+    duperr(&fa, fd_err, STDERR_FILENO);
+    if ((*sp)->cwd != NULL &&
+        (err = posix_spawn_file_actions_addchdir_np(&fa, (*sp)->cwd)) != 0)
+    {
+        /* There was an error adding the directory change so print it and
+         * exit the program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In spawn(): chdir %s - %s\n",
+                timestamp(), (*sp)->cwd, strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    /* SIGCHLD may be blocked for the signalfd, which the child must not
+     * inherit. */
+    posix_spawnattr_init(&attr);
+    flags = 0;
+    if (sigchld.fd != -1)
+    {
+        pthread_sigmask(SIG_SETMASK, NULL, &mask);
+        sigdelset(&mask, SIGCHLD);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        flags |= POSIX_SPAWN_SETSIGMASK;
+    }
+
+    /* Put the child in a process group or session of its own if asked
+     * to. */
+    if ((*sp)->group == SUBPROC_PGROUP)
+    {
+        posix_spawnattr_setpgroup(&attr, 0);
+        flags |= POSIX_SPAWN_SETPGROUP;
+    }
+    else if ((*sp)->group == SUBPROC_SESSION)
+        flags |= POSIX_SPAWN_SETSID;
+
+    /* SIGPIPE may be ignored for the stdin pipes, which the child must not
+     * inherit. */
+    if (sigpipe_ignored)
+    {
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGPIPE);
+        posix_spawnattr_setsigdefault(&attr, &mask);
+        flags |= POSIX_SPAWN_SETSIGDEF;
+    }
+    posix_spawnattr_setflags(&attr, flags);
+
+    /* Create the child process. The child shares our memory until it has
+     * executed the command, so no page tables are copied. */
+    if ((err = posix_spawn(&(*sp)->pid, path, &fa, &attr, argv, envp)) != 0)
+    {
+        /* There was an error creating the child process so print it and
+         * exit the program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In spawn(): posix_spawn() - %s\n",
+                timestamp(), strerror(err));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Get a file descriptor referring to the process, which lets it be
+     * signalled and waited for without racing against pid reuse. */
+    (*sp)->running = true;
+    (*sp)->pidfd = pidfd((*sp)->pid);
+
+    /* Move the child into its cgroup if clone3() could not start it there.
+     * It may have started running outside it, and stays outside it if it
+     * cannot be moved. */
+    if ((*sp)->cg.fd != -1)
+        cgroup_write((*sp)->cg.fd, "cgroup.procs", "%d", (int) (*sp)->pid);
+
+    /* Cleaning up. */
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+}
+
+/**
+ * This is a cache of the paths that program names have been resolved to.
+ */
+struct path_cache {
+    char* env;      /* The value of PATH the entries were resolved with. */
+    char** names;   /* The program names. */
+    char** paths;   /* The paths the names were resolved to. */
+    size_t len;     /* The number of entries. */
+};
+
+/**
+ * The paths that have been resolved so far.
+ */
+static struct path_cache pcache = { NULL, NULL, NULL, 0 };
+
+/**
+ * This function empties the path cache and remembers the value of PATH that
+ * the next entries will be resolved with.
+ */
+void pcache_reset(char* env)
+{
+    size_t i;   /* Index of the current entry. */
+
+    /* Free the entries. */
+    for (i = 0; i < pcache.len; i++)
+    {
+        free(pcache.names[i]);
+        free(pcache.paths[i]);
+    }
+    free(pcache.names);
+    free(pcache.paths);
+    free(pcache.env);
+    pcache.names = NULL;
+    pcache.paths = NULL;
+    pcache.len = 0;
+
+    /* Remember the new value of PATH. */
+    strfmt(&pcache.env, "%s", env);
+}
+
+/**
+ * This function returns the path of the executable that the program name
+ * provided to it refers to. Names containing a slash are returned as they
+ * are, others are searched for in PATH. The returned string belongs to the
+ * path cache. If the program cannot be found the error is printed on stderr
+ * and the program exits.
+ */
+char* resolve(char* name)
+{
+    char* env;      /* The value of PATH. */
+    char* dir;      /* The start of the current directory in PATH. */
+    char* end;      /* The end of the current directory in PATH. */
+    char buf[256];  /* Space to build candidate paths in. */
+    strbuf path;    /* The current candidate path. */
+    struct stat st; /* Information about the candidate. */
+    size_t i;       /* Index of the current entry. */
+
+    /* Names with a slash are not looked up. */
+    if (strchr(name, '/') != NULL)
+        return name;
+
+    /* Start again if PATH has changed since the cache was filled. */
+    if ((env = getenv("PATH")) == NULL)
+        env = "/usr/local/bin:/bin:/usr/bin";
+    if (pcache.env == NULL || strcmp(pcache.env, env) != 0)
+        pcache_reset(env);
+
+    /* Look for the name in the cache. */
+    for (i = 0; i < pcache.len; i++)
+        if (strcmp(pcache.names[i], name) == 0)
+            return pcache.paths[i];
+
+    /* Search the directories in PATH. Candidates are built on the stack. */
+    strbuf_init(&path, buf, sizeof(buf));
+    for (dir = env; ; dir = end + 1)
+    {
+        /* Find the end of the directory. An empty directory means the
+         * current directory. */
+        if ((end = strchr(dir, ':')) == NULL)
+            end = dir + strlen(dir);
+        strbuf_reset(&path);
+        if (end == dir)
+            strbuf_fmt(&path, "./%s", name);
+        else
+            strbuf_fmt(&path, "%.*s/%s", (int) (end - dir), dir, name);
+
+        /* Check whether the candidate is an executable file. */
+        if (stat(path.str, &st) == 0 && S_ISREG(st.st_mode) &&
+            access(path.str, X_OK) == 0)
+        {
+            /* Add the path to the cache. */
+            pcache.names = (char**) realloc(pcache.names,
+                                        sizeof(char*) * (pcache.len + 1));
+            pcache.paths = (char**) realloc(pcache.paths,
+                                        sizeof(char*) * (pcache.len + 1));
+            strfmt(&pcache.names[pcache.len], "%s", name);
+            strfmt(&pcache.paths[pcache.len], "%s", path.str);
+            strbuf_free(&path);
+            return pcache.paths[pcache.len++];
+        }
+
+        /* Stop after the last directory. */
+        if (*end == '\0')
+            break;
+    }
+
+    /* The program could not be found so print the error and exit the
+     * program. */
+    strbuf_free(&path);
+    fprintf(stderr,
+            "[ %s ] ERROR: In resolve(): %s - command not found\n",
+            timestamp(), name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * This function launches the program at the path provided to it as a
+ * sub-process, writing its output to files that are named after the name
+ * provided to this function, and the number of the launch if the subproc was
+ * asked to number its files with subproc_numberfiles(), prefixed with fdir
+ * and opened relative to the directory referred to by dirfd. Nothing is
+ * printed.
+ */
+void start(subproc* sp, char* path, char* const argv[], char* const envp[],
+                                        char* name, int dirfd, char* fdir)
+{
+    static unsigned long n = 0; /* The number of numbered launches. */
+    unsigned long seq = 0;      /* The number of this launch, or 0. */
+    int fds_in[2];              /* The pipe for stdin. */
+    int fd_in;                  /* The file descriptor for stdin. */
+    int fd_out;                 /* The file descriptor for stdout. */
+    int fd_err;                 /* The file descriptor for stderr. */
+    char* fname_out;            /* The file name for the stdout file. */
+    char* fname_err;            /* The file name for the stderr file. */
+    char* c;                    /* The current char of the record's name. */
+
+    /* The file name extensions. */
+    char* fext_out = "_out.txt";
+    char* fext_err = "_err.txt";
+
+    /* The strings built by the previous launch are no longer needed, and
+     * neither is anything the evloop was watching for it. */
+    arena_reset(&(*sp)->scratch);
+    detach(sp);
+
+    /* Number the launch if asked to, so its files do not replace those of
+     * another launch of the same command. */
+    if ((*sp)->numbered)
+        seq = ++n;
+
+    /* Give the child a pipe to read its stdin from if it is to be written
+     * to, or else nothing. The parent's end is non-blocking so writing to it
+     * never stalls the evloop. */
+    if ((*sp)->redir[STDIN_FILENO] != -1)
+        fd_in = (*sp)->redir[STDIN_FILENO];
+    else if ((*sp)->in.enabled)
+    {
+        mkpipe(fds_in);
+        fcntl(fds_in[1], F_SETFL, O_NONBLOCK);
+        (*sp)->in.fd = fds_in[1];
+        fd_in = fds_in[0];
+    }
+    else
+        fd_in = openfd("/dev/null", O_RDONLY | O_CLOEXEC, 0);
+
+    /* Connect stdout and stderr to pipes that the parent drains, or to
+     * files. The files are closed on exec, so only the duplicates made by
+     * the child survive in it. */
+    if ((*sp)->redir[STDOUT_FILENO] != -1)
+        fd_out = (*sp)->redir[STDOUT_FILENO];
+    else if ((*sp)->out.keep || (*sp)->out.nsinks > 0)
+        fd_out = capture_open(&(*sp)->out);
+    else
+    {
+        fname_out = mkfname(&(*sp)->scratch, fdir, name, seq, fext_out);
+        fd_out = openfdat(dirfd, fname_out,
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    }
+    if ((*sp)->redir[STDERR_FILENO] != -1)
+        fd_err = (*sp)->redir[STDERR_FILENO];
+    else if ((*sp)->err.keep || (*sp)->err.nsinks > 0)
+        fd_err = capture_open(&(*sp)->err);
+    else
+    {
+        fname_err = mkfname(&(*sp)->scratch, fdir, name, seq, fext_err);
+        fd_err = openfdat(dirfd, fname_err,
+                          O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    }
+
+    /* Start a new record, named after the command without anything that
+     * would break a line of CSV. */
+    memset(&(*sp)->m, 0, sizeof(subproc_metrics));
+    snprintf((*sp)->m.name, sizeof((*sp)->m.name), "%s", name);
+    for (c = (*sp)->m.name; (c = strpbrk(c, ",\"\r\n")) != NULL; c++)
+        *c = ' ';
+
+    /* Execute the program as the child process, timing how long it takes to
+     * be executed. */
+    (*sp)->start_ns = mono_now();
+    spawn(sp, path, argv, envp, fd_in, fd_out, fd_err);
+    (*sp)->m.spawn_ns = mono_now() - (*sp)->start_ns;
+    (*sp)->m.pid = (int32_t) (*sp)->pid;
+
+    /* The child has its own copies of the descriptors now, so close
+     * ours. */
+    closefd(fd_in);
+    closefd(fd_out);
+    closefd(fd_err);
+    (*sp)->redir[0] = (*sp)->redir[1] = (*sp)->redir[2] = -1;
+}
+
+/**
+ * This function launches the program at the path provided to it as a
+ * sub-process, writing its output to files in fdir that are named after the
+ * name provided to this function, and the number of the launch if asked for.
+ */
+void launch(subproc* sp, char* path, char* const argv[], char* const envp[],
+                                        char* name, char* fdir)
+{
+    /* Print status message. */
+    fprintf(stdout,
+            "[ %s ] Creating sub-process...\n",
+            timestamp());
+
+    /* Launch the program, opening its files relative to the working
+     * directory. */
+    start(sp, path, argv, envp, name, AT_FDCWD, fdir);
+
+    /* Print a status message. */
+    fprintf(stdout,
+            "[ %s ] Sub-process created... Executing command...\n",
+            timestamp());
+}
+
+/**
+ * This function executes the command provided to it as a sub-process.
+ */
+void subproc_exec( subproc* sp, char* cmd, char* fdir )
+{
+    /* The arguments for the shell. */
+    char* argv[] = { "sh", "-c", cmd, NULL };
+
+    /* Execute the command through the shell. */
+    launch(sp, "/bin/sh", argv, environ, cmd, fdir);
+}
+
+/**
+ * This function executes the program named by argv[0] as a sub-process,
+ * without going through a shell.
+ */
+void subproc_execv(subproc* sp, char* const argv[], char* const envp[],
+                                                    char* fdir)
+{
+    /* Execute the program directly. */
+    launch(sp, resolve(argv[0]), argv, (envp != NULL) ? envp : environ,
+                                 argv[0], fdir);
+}
+
+/**
+ * This function returns a copy of the environment of the program, made in a
+ * single block that holds both the pointers and the strings, so it is freed
+ * with a single call to free().
+ */
+char** envdup()
+{
+    char** env;     /* The copy. */
+    char* str;      /* Where the next string is copied to. */
+    size_t n;       /* The number of variables. */
+    size_t len;     /* The number of bytes the strings take up. */
+    size_t i;       /* Index of the current variable. */
+
+    /* Measure the environment. */
+    for (n = 0, len = 0; environ[n] != NULL; n++)
+        len += strlen(environ[n]) + 1;
+
+    /* Copy the pointers' targets in after the pointers. */
+    env = (char**) malloc(sizeof(char*) * (n + 1) + len);
+    str = (char*) (env + n + 1);
+    for (i = 0; i < n; i++)
+    {
+        len = strlen(environ[i]) + 1;
+        env[i] = memcpy(str, environ[i], len);
+        str += len;
+    }
+    env[n] = NULL;
+
+    return env;
+}
+
+/**
+ * This function executes the n commands described by specs as sub-processes,
+ * one in each of the subprocs provided to it.
+ */
+void subproc_exec_many(subproc* sps, const subproc_spec* specs, size_t n,
+                                                                char* fdir)
+{
+    char** paths;   /* The executables of the commands. */
+    char** names;   /* What the output files of the commands are named
+                       after. */
+    char** env;     /* The environment the batch was started with. */
+    int dirfd;      /* The directory the output files are written to. */
+    size_t i;       /* Index of the current command. */
+
+    /* The arguments for the shell. */
+    char* shargv[] = { "sh", "-c", NULL, NULL };
+
+    /* Print status message. */
+    fprintf(stdout,
+            "[ %s ] Creating %zu sub-processes...\n",
+            timestamp(), n);
+
+    /* Resolve every executable up front, so nothing is started if one of
+     * them cannot be found. */
+    paths = (char**) malloc(sizeof(char*) * (n + 1));
+    names = (char**) malloc(sizeof(char*) * (n + 1));
+    for (i = 0; i < n; i++)
+    {
+        if (specs[i].argv != NULL)
+        {
+            paths[i] = resolve(specs[i].argv[0]);
+            names[i] = specs[i].argv[0];
+        }
+        else
+        {
+            paths[i] = "/bin/sh";
+            names[i] = specs[i].cmd;
+        }
+    }
+
+    /* Open the output directory once, so each file is opened relative to it
+     * without the path being walked again. */
+    dirfd = openfd((fdir[0] != '\0') ? fdir : ".",
+                   O_PATH | O_DIRECTORY | O_CLOEXEC, 0);
+
+    /* Take a copy of the environment, so every command of the batch gets the
+     * same one even if it is changed while the batch is being started. */
+    env = envdup();
+
+    /* Launch the commands. */
+    for (i = 0; i < n; i++)
+    {
+        shargv[2] = specs[i].cmd;
+        start(&sps[i], paths[i],
+              (specs[i].argv != NULL) ? specs[i].argv : shargv,
+              (specs[i].envp != NULL) ? specs[i].envp : env,
+              names[i], dirfd, "");
+    }
+
+    /* Print a status message. */
+    fprintf(stdout,
+            "[ %s ] %zu sub-processes created... Executing commands...\n",
+            timestamp(), n);
+
+    /* Cleaning up. */
+    closefd(dirfd);
+    free(env);
+    free(paths);
+    free(names);
+}
+
+/**
+ * This function samples /proc/<pid>/stat and /proc/<pid>/io of the
+ * sub-process into its metrics. The files are opened on the first sample and
+ * kept open until the sub-process is reaped.
+ */
+void sample(subproc* sp)
+{
+    char buf[1024];     /* The contents of a file. */
+    char* field;        /* The current field of the stat file. */
+    uint64_t rss_kb;    /* The resident memory. */
+    int i;              /* Number of the current field. */
+
+    /* Open the files the first time. */
+    if ((*sp)->statfd == -1)
+    {
+        snprintf(buf, sizeof(buf), "/proc/%d/stat", (int) (*sp)->pid);
+        (*sp)->statfd = open(buf, O_RDONLY | O_CLOEXEC);
+        snprintf(buf, sizeof(buf), "/proc/%d/io", (int) (*sp)->pid);
+        (*sp)->iofd = open(buf, O_RDONLY | O_CLOEXEC);
+    }
+    (*sp)->m.samples++;
+
+    /* The resident set size is the 24th field of the stat file, counted in
+     * pages. The command name in the 2nd field may contain spaces, so the
+     * fields are counted from the bracket after it. */
+    if (counter_read((*sp)->statfd, buf, sizeof(buf)) > 0 &&
+        (field = strrchr(buf, ')')) != NULL)
+    {
+        for (i = 2; i < 24 && field != NULL; i++)
+            if ((field = strchr(field + 1, ' ')) != NULL)
+                field++;
+        if (field != NULL)
+        {
+            rss_kb = strtoull(field, NULL, 10) *
+                     (uint64_t) sysconf(_SC_PAGESIZE) / 1024;
+            if (rss_kb > (*sp)->m.rss_peak_kb)
+                (*sp)->m.rss_peak_kb = rss_kb;
+        }
+    }
+
+    /* Pick out the I/O counters. */
+    if (counter_read((*sp)->iofd, buf, sizeof(buf)) > 0)
+    {
+        if ((field = strstr(buf, "rchar: ")) != NULL)
+            (*sp)->m.rchar = strtoull(field + 7, NULL, 10);
+        if ((field = strstr(buf, "wchar: ")) != NULL)
+            (*sp)->m.wchar = strtoull(field + 7, NULL, 10);
+        if ((field = strstr(buf, "\nread_bytes: ")) != NULL)
+            (*sp)->m.read_bytes = strtoull(field + 13, NULL, 10);
+        if ((field = strstr(buf, "\nwrite_bytes: ")) != NULL)
+            (*sp)->m.write_bytes = strtoull(field + 14, NULL, 10);
+    }
+}
+
+/**
+ * This function is called by the evloop every sampling interval while the
+ * sub-process runs.
+ */
+void on_sample(evloop* ev, evloop_timer* t, void* arg)
+{
+    subproc sp = (subproc) arg;     /* The sub-process being sampled. */
+
+    sample(&sp);
+}
+
+/**
+ * This function stops the evloop and the SIGCHLD handler from watching the
+ * sub-process, and closes its pidfd.
+ */
+void unwatch(subproc* sp)
+{
+    size_t i;   /* Index of the current watched sub-process. */
+
+    /* Stop watching the pidfd, or remove the process from the list that is
+     * checked when SIGCHLD arrives. */
+    if ((*sp)->pidfd != -1)
+    {
+        if ((*sp)->ev != NULL)
+            evloop_delfd((*sp)->ev, (*sp)->pidfd);
+        closefd((*sp)->pidfd);
+        (*sp)->pidfd = -1;
+    }
+    else
+    {
+        for (i = 0; i < sigchld.len; i++)
+        {
+            if (sigchld.sps[i] == *sp)
+            {
+                sigchld.sps[i] = sigchld.sps[--sigchld.len];
+                break;
+            }
+        }
+    }
+}
+
+/**
+ * This function lets go of the sub-process's last launch: its stdin and
+ * capture pipes are closed and it is no longer watched, sampled or
+ * terminated, which it may still be if it was never reaped or something else
+ * held its pipes open after it exited. The evloop is forgotten, so the next
+ * launch is only watched once subproc_watch() is called for it.
+ */
+void detach(subproc* sp)
+{
+    /* Close the pipes. */
+    feed_close(sp);
+    capture_close(&(*sp)->out, (*sp)->ev);
+    capture_close(&(*sp)->err, (*sp)->ev);
+
+    /* Stop watching, sampling and terminating the process. */
+    unwatch(sp);
+    if ((*sp)->sampler != NULL)
+    {
+        evloop_deltimer((*sp)->ev, &(*sp)->sampler);
+        (*sp)->sampler = NULL;
+    }
+    if ((*sp)->termtimer != NULL)
+    {
+        evloop_deltimer((*sp)->ev, &(*sp)->termtimer);
+        (*sp)->termtimer = NULL;
+    }
+    if ((*sp)->statfd != -1)
+        closefd((*sp)->statfd);
+    if ((*sp)->iofd != -1)
+        closefd((*sp)->iofd);
+    (*sp)->statfd = (*sp)->iofd = -1;
+    (*sp)->ev = NULL;
+}
+
+/**
+ * This function records that the sub-process exited with the status and
+ * resource usage provided to it, stops it from being watched, and calls the
+ * function registered with subproc_watch().
+ */
+void reap(subproc* sp, int status, struct rusage* ru)
+{
+    /* Record the exit status and what the process cost. */
+    (*sp)->running = false;
+    (*sp)->status = status;
+    (*sp)->m.status = status;
+    (*sp)->m.wall_ns = mono_now() - (*sp)->start_ns;
+    (*sp)->m.utime_us = (uint64_t) ru->ru_utime.tv_sec * 1000000 +
+                        (uint64_t) ru->ru_utime.tv_usec;
+    (*sp)->m.stime_us = (uint64_t) ru->ru_stime.tv_sec * 1000000 +
+                        (uint64_t) ru->ru_stime.tv_usec;
+    (*sp)->m.maxrss_kb = (uint64_t) ru->ru_maxrss;
+
+    /* Stop sampling the process. */
+    if ((*sp)->sampler != NULL)
+    {
+        evloop_deltimer((*sp)->ev, &(*sp)->sampler);
+        (*sp)->sampler = NULL;
+    }
+
+    /* There is nothing left to terminate, except what the process left
+     * behind in its group if it was being terminated. */
+    if ((*sp)->termtimer != NULL)
+    {
+        evloop_deltimer((*sp)->ev, &(*sp)->termtimer);
+        (*sp)->termtimer = NULL;
+    }
+    if ((*sp)->terminating && (*sp)->leader)
+        kill(-(*sp)->pid, SIGKILL);
+    (*sp)->terminating = false;
+    if ((*sp)->statfd != -1)
+        closefd((*sp)->statfd);
+    if ((*sp)->iofd != -1)
+        closefd((*sp)->iofd);
+    (*sp)->statfd = (*sp)->iofd = -1;
+
+    /* Nothing more can be written to the process. */
+    feed_close(sp);
+
+    /* Collect the output the process wrote before exiting. Without an evloop
+     * nothing would drain the pipes later, so they are closed. */
+    capture_drain(&(*sp)->out, (*sp)->ev);
+    capture_drain(&(*sp)->err, (*sp)->ev);
+    if ((*sp)->ev == NULL)
+    {
+        capture_close(&(*sp)->out, NULL);
+        capture_close(&(*sp)->err, NULL);
+    }
+
+    /* Stop watching the process. */
+    unwatch(sp);
+
+    /* Tell the watcher that the process has exited. */
+    if ((*sp)->fn != NULL)
+        (*sp)->fn(&(*sp)->self, status, (*sp)->arg);
+}
+
+/**
+ * This function reaps the sub-process if it has exited, without waiting.
+ * It returns true if the sub-process was reaped.
+ */
+bool tryreap(subproc* sp)
+{
+    siginfo_t si;       /* How the process exited. */
+    int status;         /* The exit status of the process. */
+    struct rusage ru;   /* What the process used. */
+    pid_t pid;          /* The pid that was reaped. */
+
+    /* Check whether the process has exited, leaving it to be reaped. Every
+     * watched process is tried when SIGCHLD arrives, so this keeps those that
+     * are still running from being sampled. */
+    si.si_pid = 0;
+    while (waitid(P_PID, (id_t) (*sp)->pid, &si,
+                  WEXITED | WNOHANG | WNOWAIT) == -1 && errno == EINTR);
+    if (si.si_pid != (*sp)->pid)
+        return false;
+
+    /* Take a last sample while the process can still be looked at. */
+    if ((*sp)->sampler != NULL)
+        sample(sp);
+
+    /* Reap the process. */
+    while ((pid = wait4((*sp)->pid, &status, WNOHANG, &ru)) == -1 &&
+           errno == EINTR);
+    if (pid != (*sp)->pid)
+        return false;
+
+    /* The process has exited so reap it. */
+    reap(sp, status, &ru);
+    return true;
+}
+
+/**
+ * This function is called by the evloop when a watched pidfd becomes
+ * readable, which happens when its process exits.
+ */
+void on_pidfd(evloop* ev, int fd, uint32_t events, void* arg)
+{
+    subproc sp = (subproc) arg;     /* The sub-process that exited. */
+
+    /* Reap the process. */
+    tryreap(&sp);
+}
+
+/**
+ * This function is called by the evloop when SIGCHLD has been received, and
+ * reaps any watched sub-processes that have exited.
+ */
+void on_sigchld(evloop* ev, int fd, uint32_t events, void* arg)
+{
+    struct signalfd_siginfo si;     /* The signal that was received. */
+    size_t i;                       /* Index of the current sub-process. */
+    subproc sp;                     /* The current sub-process. */
+
+    /* Drain the signalfd. Several SIGCHLDs may have been merged into one. */
+    while (read(fd, &si, sizeof(si)) == sizeof(si));
+
+    /* Reap the sub-processes that have exited. Reaping removes a
+     * sub-process from the list, so the same index is checked again. */
+    for (i = 0; i < sigchld.len;)
+    {
+        sp = sigchld.sps[i];
+        if (!tryreap(&sp))
+            i++;
+    }
+}
+
+/**
+ * This function registers the sub-process with the evloop provided to it.
+ */
+void subproc_watch(subproc* sp, evloop* ev, subproc_exitfn fn, void* arg)
+{
+    sigset_t mask;  /* The signals to receive through the signalfd. */
+
+    /* Remember who to tell when the process exits. */
+    (*sp)->ev = ev;
+    (*sp)->fn = fn;
+    (*sp)->arg = arg;
+
+    /* Sample /proc while the process runs if asked to. */
+    if ((*sp)->interval > 0 && (*sp)->running && (*sp)->sampler == NULL)
+        (*sp)->sampler = evloop_addtimer(ev, 0, (*sp)->interval, on_sample,
+                                             *sp);
+
+    /* Write to stdin as the pipe has room, starting with whatever was
+     * queued before the process was watched. */
+    if ((*sp)->in.fd != -1)
+    {
+        evloop_addfd(ev, (*sp)->in.fd, 0, on_stdin, *sp);
+        feed_run(sp);
+    }
+
+    /* Drain the captured streams as data arrives. */
+    if ((*sp)->out.fd != -1)
+        evloop_addfd(ev, (*sp)->out.fd, EPOLLIN, on_capture, *sp);
+    if ((*sp)->err.fd != -1)
+        evloop_addfd(ev, (*sp)->err.fd, EPOLLIN, on_capture, *sp);
+
+    /* Watch the pidfd if there is one. */
+    if ((*sp)->pidfd != -1)
+    {
+        evloop_addfd(ev, (*sp)->pidfd, EPOLLIN, on_pidfd, *sp);
+        return;
+    }
+
+    /* Otherwise receive SIGCHLD through a signalfd. */
+    if (sigchld.fd == -1)
+    {
+        sigemptyset(&mask);
+        sigaddset(&mask, SIGCHLD);
+        pthread_sigmask(SIG_BLOCK, &mask, NULL);
+        if ((sigchld.fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC))
+            == -1)
+        {
+            /* There was an error creating the signalfd so print it and
+             * exit the program. */
+            fprintf(stderr,
+                    "[ %s ] ERROR: In subproc_watch(): signalfd() - %s\n",
+                    timestamp(), strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        evloop_addfd(ev, sigchld.fd, EPOLLIN, on_sigchld, NULL);
+    }
+
+    /* Add the sub-process to the list. */
+    if (sigchld.len == sigchld.cap)
+    {
+        sigchld.cap = (sigchld.cap > 0) ? sigchld.cap * 2 : 16;
+        sigchld.sps = (subproc*) realloc(sigchld.sps,
+                                         sizeof(subproc) * sigchld.cap);
+    }
+    sigchld.sps[sigchld.len++] = *sp;
+
+    /* The process may have exited before SIGCHLD was blocked. */
+    tryreap(sp);
+}
+
+/**
+ * This function registers the n subprocs provided to it with the evloop
+ * provided, as subproc_watch() does.
+ */
+void subproc_watch_many(subproc* sps, size_t n, evloop* ev, subproc_exitfn fn,
+                                                              void* arg)
+{
+    size_t i;   /* Index of the current subproc. */
+
+    for (i = 0; i < n; i++)
+        subproc_watch(&sps[i], ev, fn, arg);
+}
+
+/**
+ * This function returns the process id of the sub-process.
+ */
+pid_t subproc_pid(subproc* sp)
+{
+    return (*sp)->pid;
+}
+
+/**
+ * This function returns true if the sub-process has been executed and has not
+ * been reaped yet.
+ */
+bool subproc_running(subproc* sp)
+{
+    return (*sp)->running;
+}
+
+/**
+ * This function returns the status that wait4() reported for the
+ * sub-process when it was reaped.
+ */
+int subproc_status(subproc* sp)
+{
+    return (*sp)->status;
+}
+
+/**
+ * This function empties the termination policy provided to it.
+ */
+void subproc_termpolicy_init(subproc_termpolicy* policy, bool group)
+{
+    policy->nsteps = 0;
+    policy->group = group;
+}
+
+/**
+ * This function adds a step to the termination policy provided to it.
+ */
+void subproc_termpolicy_add(subproc_termpolicy* policy, int sig,
+                                                        uint64_t grace)
+{
+    /* Ignore steps that do not fit. */
+    if (policy->nsteps == SUBPROC_MAX_TERMSTEPS)
+        return;
+
+    policy->steps[policy->nsteps].sig = sig;
+    policy->steps[policy->nsteps].grace = grace;
+    policy->nsteps++;
+}
+
+/**
+ * This function sets the termination policy used to stop the sub-process.
+ */
+void subproc_setterm(subproc* sp, const subproc_termpolicy* policy)
+{
+    /* Use the policy provided, unless it has no steps, which would leave
+     * the process to be waited for forever without being signalled. */
+    if (policy != NULL && policy->nsteps > 0)
+    {
+        (*sp)->term = *policy;
+        return;
+    }
+
+    /* Otherwise ask nicely, then insist. */
+    subproc_termpolicy_init(&(*sp)->term, false);
+    subproc_termpolicy_add(&(*sp)->term, SIGTERM, 2 * NANOS_PER_SEC);
+    subproc_termpolicy_add(&(*sp)->term, SIGKILL, 0);
+}
+
+/**
+ * This function sends a signal to the sub-process, or to its process group if
+ * group is true and it leads one of its own. It returns -1 on error, as
+ * kill() does.
+ */
+int groupsend(subproc* sp, int sig, bool group)
+{
+    pid_t pgid;     /* The process group of the sub-process. */
+
+    /* Signal the group if the process was started as its leader. The group
+     * outlives the leader, so this works after it has been reaped. */
+    if ((*sp)->leader)
+        return kill(-(*sp)->pid, sig);
+
+    /* Otherwise signal the group only if the process has since made one
+     * that is not ours. */
+    if (group && (*sp)->running &&
+        (pgid = getpgid((*sp)->pid)) == (*sp)->pid && pgid != getpgrp())
+        return kill(-pgid, sig);
+
+    return sigsend(sp, sig);
+}
+
+/**
+ * This function sends a signal as a step of the termination policy, and
+ * continues the process if it was suspended so that it can act on it.
+ */
+void termsend(subproc* sp, int sig)
+{
+    groupsend(sp, sig, (*sp)->term.group);
+    if ((*sp)->suspended && sig != SIGKILL)
+        groupsend(sp, SIGCONT, (*sp)->term.group);
+}
+
+/**
+ * This function sets the process group the sub-process is started in.
+ */
+void subproc_setgroup(subproc* sp, enum subproc_group group)
+{
+    (*sp)->group = group;
+}
+
+/**
+ * This function sends a signal to the sub-process, or to its whole process
+ * group if it leads one.
+ */
+int subproc_signal(subproc* sp, int sig)
+{
+    /* A process that has been reaped can only be signalled through the
+     * group it led. */
+    if (!(*sp)->running && !(*sp)->leader)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+
+    return groupsend(sp, sig, false);
+}
+
+/**
+ * This function stops the sub-process, and its process group if it leads
+ * one.
+ */
+int subproc_suspend(subproc* sp)
+{
+    int ret;    /* What kill() returned. */
+
+    if ((ret = subproc_signal(sp, SIGSTOP)) == 0)
+        (*sp)->suspended = true;
+
+    return ret;
+}
+
+/**
+ * This function continues a sub-process stopped by subproc_suspend().
+ */
+int subproc_resume(subproc* sp)
+{
+    int ret;    /* What kill() returned. */
+
+    if ((ret = subproc_signal(sp, SIGCONT)) == 0)
+        (*sp)->suspended = false;
+
+    return ret;
+}
+
+/**
+ * This function waits up to grace nanoseconds for the sub-process to exit,
+ * or for as long as it takes if forever is true. It returns the pid that
+ * wait4() reported, which is 0 if the sub-process is still running.
+ */
+pid_t waitexit(subproc* sp, uint64_t grace, bool forever, int* status,
+                                                          struct rusage* ru)
+{
+    struct pollfd pfd;              /* The pidfd to wait on. */
+    struct timespec nap = { 0, 1000000 };   /* How long to sleep for. */
+    uint64_t deadline;              /* When to stop waiting. */
+    uint64_t now;                   /* The current time. */
+    uint64_t left;                  /* Milliseconds left to wait. */
+    pid_t pid;                      /* The pid that was reaped. */
+
+    /* Block until the process exits. */
+    if (forever)
+    {
+        while ((pid = wait4((*sp)->pid, status, 0, ru)) == -1 &&
+               errno == EINTR);
+        return pid;
+    }
+
+    for (deadline = deadline_in(grace); ; )
+    {
+        /* Check whether the process has exited. */
+        while ((pid = wait4((*sp)->pid, status, WNOHANG, ru)) == -1 &&
+               errno == EINTR);
+        if (pid != 0 || deadline_passed(deadline))
+            return pid;
+
+        /* Sleep until it exits, which the pidfd reports, or for a moment if
+         * there is no pidfd. The deadline may pass after it was checked, and
+         * poll() takes an int where -1 means forever, so the time left is
+         * kept between 0 and INT_MAX milliseconds. */
+        now = mono_now();
+        left = (deadline > now) ? (deadline - now + 999999) / 1000000 : 0;
+        if ((*sp)->pidfd != -1)
+        {
+            pfd.fd = (*sp)->pidfd;
+            pfd.events = POLLIN;
+            poll(&pfd, 1, (left < INT_MAX) ? (int) left : INT_MAX);
+        }
+        else
+            nanosleep(&nap, NULL);
+    }
+}
+
+/**
+ * This function terminates the provided sub-process by following its
+ * termination policy, waits for it to exit, and reports its exit-status to
+ * stdout or stderr if there was an error.
+ */
+void subproc_term( subproc* sp )
+{
+    subproc_termpolicy* term;   /* How to terminate the process. */
+    int status;                 /* The exit status of the process. */
+    struct rusage ru;           /* What the process used. */
+    pid_t pid;                  /* The pid that was reaped. */
+    size_t i;                   /* Index of the current step. */
+
+    /* Print a status message. */
+    fprintf(stdout, 
+            "[ %s ] Terminating sub-process...\n", 
+            timestamp());
+
+    /* Take the steps of the policy until the process exits, unless it has
+     * already been reaped, then wait for it without a deadline. */
+    if ((*sp)->running)
+    {
+        (*sp)->terminating = true;
+        term = &(*sp)->term;
+        for (i = 0, pid = 0; i < term->nsteps && pid == 0; i++)
+        {
+            termsend(sp, term->steps[i].sig);
+            pid = waitexit(sp, term->steps[i].grace, i + 1 == term->nsteps,
+                           &status, &ru);
+        }
+        if (pid == 0)
+            pid = waitexit(sp, 0, true, &status, &ru);
+        if (pid == -1)
+        {
+            /* There was an error waiting for the process to exit so print
+             * the error. */
+            fprintf(stderr, 
+                    "[ %s ] ERROR: in subproc_term(): wait() error!\n",
+                    timestamp());
+            return;
+        }
+        reap(sp, status, &ru);
+    }
+
+    /* Look at what happened to the process. */
+    status = (*sp)->status;
+    if (WIFEXITED(status))
+    {
+        /* The process exited normally so print its exit status. */
+        fprintf(stdout,
+                "[ %s ] The process exited normally with exit"
+                " status %d.\n", 
+                timestamp(), WEXITSTATUS(status));
+    }
+    else if (WIFSIGNALED(status))
+    {
+        /* The process exited because of an uncaught signal. */
+        fprintf(stdout, 
+                "[ %s ] The process did not exit normally\n",
+                timestamp());
+    }
+    else
+    {
+        /* The process did not exit. */
+        fprintf(stdout, 
+                "[ %s ] The child process did not exit\n",
+                timestamp());
+    }
+}
+
+/**
+ * This function makes the evloop the sub-process is watched with sample its
+ * /proc files every interval nanoseconds while it runs.
+ */
+void subproc_sample(subproc* sp, uint64_t interval)
+{
+    (*sp)->interval = interval;
+}
+
+/**
+ * This function copies the metrics of the sub-process's last run to m.
+ */
+void subproc_getmetrics(subproc* sp, subproc_metrics* m)
+{
+    *m = (*sp)->m;
+}
+
+/**
+ * This function writes the names of the CSV columns written by
+ * subproc_metrics_writecsv() to the file stream provided to it.
+ */
+void subproc_metrics_csvheader(FILE* fs)
+{
+    writefss(fs, "name,pid,status,spawn_ns,wall_ns,utime_us,stime_us,"
+                 "maxrss_kb,samples,rss_peak_kb,rchar,wchar,read_bytes,"
+                 "write_bytes\n");
+}
+
+/**
+ * This function writes the metrics provided to it to the file stream provided
+ * to it as a line of CSV.
+ */
+void subproc_metrics_writecsv(FILE* fs, const subproc_metrics* m)
+{
+    fprintf(fs, "%.*s,%d,%d,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,%llu,"
+                "%llu,%llu\n",
+            (int) sizeof(m->name), m->name, (int) m->pid, (int) m->status,
+            (unsigned long long) m->spawn_ns,
+            (unsigned long long) m->wall_ns,
+            (unsigned long long) m->utime_us,
+            (unsigned long long) m->stime_us,
+            (unsigned long long) m->maxrss_kb,
+            (unsigned long long) m->samples,
+            (unsigned long long) m->rss_peak_kb,
+            (unsigned long long) m->rchar,
+            (unsigned long long) m->wchar,
+            (unsigned long long) m->read_bytes,
+            (unsigned long long) m->write_bytes);
+}
+
+/**
+ * This function writes the metrics provided to it to the file stream provided
+ * to it as a fixed-size binary record.
+ */
+void subproc_metrics_writebin(FILE* fs, const subproc_metrics* m)
+{
+    writefsn(fs, m, sizeof(subproc_metrics));
+}
+
+/**
+ * This function is called by the evloop when the grace period of a step of a
+ * termination policy has passed.
+ */
+void on_termstep(evloop* ev, evloop_timer* t, void* arg);
+
+/**
+ * This function takes the next step of the sub-process's termination policy,
+ * and times the one after it.
+ */
+void termstep(subproc* sp)
+{
+    subproc_termstep* step;     /* The step being taken. */
+
+    /* Send the step's signal. */
+    step = &(*sp)->term.steps[(*sp)->termstep++];
+    termsend(sp, step->sig);
+
+    /* Take the next step after the grace period, unless this was the
+     * last. */
+    if ((*sp)->termstep < (*sp)->term.nsteps)
+        (*sp)->termtimer = evloop_addtimer((*sp)->ev, step->grace, 0,
+                                           on_termstep, *sp);
+}
+
+/**
+ * This function is called by the evloop when the grace period of a step of a
+ * termination policy has passed without the sub-process being reaped.
+ */
+void on_termstep(evloop* ev, evloop_timer* t, void* arg)
+{
+    subproc sp = (subproc) arg;     /* The sub-process being terminated. */
+
+    /* The timer is destroyed once this returns. */
+    sp->termtimer = NULL;
+    termstep(&sp);
+}
+
+/**
+ * This function starts terminating the provided sub-process by following its
+ * termination policy, without waiting.
+ */
+void subproc_term_async(subproc* sp)
+{
+    /* Without an evloop there is nothing to time the steps. */
+    if ((*sp)->ev == NULL)
+    {
+        subproc_term(sp);
+        return;
+    }
+
+    /* Nothing to do if the process has been reaped or is already being
+     * terminated. */
+    if (!(*sp)->running || (*sp)->terminating)
+        return;
+
+    /* Take the first step. */
+    (*sp)->terminating = true;
+    (*sp)->termstep = 0;
+    termstep(sp);
+}
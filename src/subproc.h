@@ -21,14 +21,137 @@
 #include <errno.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <sys/syscall.h>
+#include <sys/signalfd.h>
+#include <sys/mman.h>
+#include <stdatomic.h>
 
 #include "mycutils.h"
+#include "evloop.h"
+
+/**
+ * This is the most file descriptors that one output stream of a sub-process
+ * can be passed on to with subproc_stream().
+ */
+#define SUBPROC_MAX_SINKS 8
+
+/**
+ * This is the most steps a termination policy can have.
+ */
+#define SUBPROC_MAX_TERMSTEPS 8
 
 /**
  * This is the subproc data-structure.
  */
 typedef struct subproc_data* subproc;
 
+/**
+ * This is the type of function that is called when everything queued for a
+ * sub-process's stdin has been written and its pipe can take more. It may
+ * queue more input with subproc_write() or subproc_sendfile(), or end it with
+ * subproc_closein(); if it does none of these it is not called again until
+ * more input is queued.
+ */
+typedef void (*subproc_feedfn)(subproc* sp, void* arg);
+
+/**
+ * This is the type of function that is called when a watched sub-process has
+ * exited. The status is the one reported by wait4().
+ */
+typedef void (*subproc_exitfn)(subproc* sp, int status, void* arg);
+
+/**
+ * This describes one command launched by subproc_exec_many(): a program and
+ * its arguments, executed as subproc_execv() does, or a shell command if argv
+ * is NULL. If envp is NULL the sub-process inherits the environment of its
+ * parent.
+ */
+typedef struct {
+    char* const* argv;  /* The program and its arguments, or NULL. */
+    char* cmd;          /* The shell command, used if argv is NULL. */
+    char* const* envp;  /* The environment, or NULL. */
+} subproc_spec;
+
+/**
+ * These are the resource limits of the cgroup a sub-process is placed in by
+ * subproc_setcgroup(). A limit of 0 means no limit.
+ */
+typedef struct {
+    uint64_t cpu_quota;     /* Microseconds of CPU time per period. */
+    uint64_t cpu_period;    /* The period in microseconds, or 0 for 100ms. */
+    uint64_t memory_max;    /* The most memory in bytes. */
+    uint64_t pids_max;      /* The most processes and threads. */
+} subproc_limits;
+
+/**
+ * This is the resource usage of the cgroup of a sub-process. Counters the
+ * kernel does not provide are 0.
+ */
+typedef struct {
+    uint64_t usage_usec;        /* CPU time used, in microseconds. */
+    uint64_t user_usec;         /* CPU time used in user mode. */
+    uint64_t system_usec;       /* CPU time used in kernel mode. */
+    uint64_t memory_current;    /* Memory in use, in bytes. */
+    uint64_t memory_peak;       /* The most memory that was in use. */
+} subproc_cgstats;
+
+/**
+ * This is what a sub-process cost. It is filled in when the sub-process is
+ * reaped, and by the /proc samples taken while it runs if subproc_sample() is
+ * used. Every field is a fixed size, so a record can be written out as it is
+ * by subproc_metrics_writebin().
+ */
+typedef struct {
+    char name[32];          /* The command, cut short if it is longer. */
+    int32_t pid;            /* The process id. */
+    int32_t status;         /* The status that wait4() reported. */
+    uint64_t spawn_ns;      /* How long starting the process took, until
+                               it had executed the command. */
+    uint64_t wall_ns;       /* How long the process ran for. */
+    uint64_t utime_us;      /* CPU time used in user mode. */
+    uint64_t stime_us;      /* CPU time used in kernel mode. */
+    uint64_t maxrss_kb;     /* The most memory that was resident. */
+    uint64_t samples;       /* The number of /proc samples taken. */
+    uint64_t rss_peak_kb;   /* The most memory resident when sampled. */
+    uint64_t rchar;         /* Bytes read, as of the last sample. */
+    uint64_t wchar;         /* Bytes written, as of the last sample. */
+    uint64_t read_bytes;    /* Bytes read from storage. */
+    uint64_t write_bytes;   /* Bytes written to storage. */
+} subproc_metrics;
+
+/**
+ * This is one step of a termination policy: a signal, and how long to give
+ * the sub-process to exit before the next step is taken.
+ */
+typedef struct {
+    int sig;            /* The signal to send. */
+    uint64_t grace;     /* Nanoseconds to wait before the next step. */
+} subproc_termstep;
+
+/**
+ * This is a termination policy: the steps taken to stop a sub-process, such
+ * as SIGINT, then SIGTERM after 200ms, then SIGKILL after 2s.
+ */
+typedef struct {
+    subproc_termstep steps[SUBPROC_MAX_TERMSTEPS];  /* The steps. */
+    size_t nsteps;      /* The number of steps. */
+    bool group;         /* Whether to signal the process group. */
+} subproc_termpolicy;
+
+/**
+ * These are the process groups a sub-process can be started in.
+ */
+enum subproc_group {
+    SUBPROC_INHERIT,    /* The parent's process group and session. */
+    SUBPROC_PGROUP,     /* A new process group that it leads. */
+    SUBPROC_SESSION     /* A new session and process group that it leads. */
+};
+
 /**
  * This function initialises the subproc provided to it.
  */
@@ -39,16 +162,320 @@ void subproc_init(subproc* sp);
  */
 void subproc_free(subproc* sp);
 
+/**
+ * This function sets the working directory that the sub-process will be
+ * started in. Passing NULL makes the sub-process inherit the working directory
+ * of its parent, which is the default. The output files given to
+ * subproc_exec() are still opened relative to the parent's directory.
+ */
+void subproc_chdir(subproc* sp, char* dir);
+
+/**
+ * This function sets whether the output files of the sub-process are named
+ * after the number of its launch as well as its command, such as ls_3_out.txt
+ * instead of ls_out.txt, from the next time it is executed. The number is
+ * unique to the launch within the program, so launches of the same command do
+ * not overwrite each other's output. Files are not numbered by default.
+ */
+void subproc_numberfiles(subproc* sp, bool numbered);
+
+/**
+ * This function places the sub-process in a cgroup v2 of its own, created
+ * under the cgroup directory parent, from the next time it is executed. The
+ * limits provided are applied to it unless limits is NULL. The sub-process is
+ * started directly inside the cgroup with clone3() where the kernel supports
+ * it, and moved into it straight after it is started otherwise. It returns
+ * false, leaving the sub-process without a cgroup, if the cgroup cannot be
+ * created or its limits cannot be set, such as when cgroup delegation is not
+ * available. The cgroup is removed when the subproc is destroyed.
+ */
+bool subproc_setcgroup(subproc* sp, char* parent,
+                                    const subproc_limits* limits);
+
+/**
+ * This function stores the resource usage of the sub-process's cgroup at st.
+ * The counter files are kept open, so this costs a few pread() calls. It
+ * returns false if the sub-process has no cgroup.
+ */
+bool subproc_cgread(subproc* sp, subproc_cgstats* st);
+
+/**
+ * This function sets the process group the sub-process is started in from
+ * the next time it is executed. A sub-process that leads its own group takes
+ * the processes it starts, such as the commands run by the shell of
+ * subproc_exec(), with it: signals from subproc_signal() and termination
+ * policies reach the whole group, and once the sub-process has been reaped
+ * after being terminated, what is left of the group is killed.
+ */
+void subproc_setgroup(subproc* sp, enum subproc_group group);
+
+/**
+ * This function sends a signal to the sub-process, or to its whole process
+ * group if it leads one. It returns -1 on error, as kill() does.
+ */
+int subproc_signal(subproc* sp, int sig);
+
+/**
+ * This function stops the sub-process, and its process group if it leads
+ * one, with SIGSTOP until subproc_resume() is called. It returns -1 on
+ * error, as kill() does.
+ */
+int subproc_suspend(subproc* sp);
+
+/**
+ * This function continues a sub-process stopped by subproc_suspend(). It
+ * returns -1 on error, as kill() does.
+ */
+int subproc_resume(subproc* sp);
+
+/**
+ * This function gives the sub-process a pipe as its stdin from the next time
+ * it is executed, instead of /dev/null. Input is queued with subproc_write()
+ * and subproc_sendfile() and written without blocking by the evloop the
+ * sub-process is watched with. No more than max bytes (64KiB if max is 0)
+ * are held in memory, and fn is called with arg, if it is not NULL, whenever
+ * the queue empties so that a producer can supply more. SIGPIPE is ignored
+ * by the program from then on, if it was not handled already, so that a child
+ * that stops reading does not kill it; children still get the default
+ * action.
+ */
+void subproc_stdin(subproc* sp, size_t max, subproc_feedfn fn, void* arg);
+
+/**
+ * This function queues n bytes from buf to be written to the sub-process's
+ * stdin, writing as much as it can straight away. It returns the number of
+ * bytes accepted, which is less than n when the queue is full; the rest
+ * should be offered again once fn has been called.
+ */
+size_t subproc_write(subproc* sp, const void* buf, size_t n);
+
+/**
+ * This function queues len bytes of the file fd, from its current offset, or
+ * everything up to its end if len is 0, to be written to the sub-process's
+ * stdin. The bytes are moved with splice() without being copied into memory.
+ * fd must stay open until they have been written; it is not closed.
+ */
+void subproc_sendfile(subproc* sp, int fd, size_t len);
+
+/**
+ * This function closes the sub-process's stdin once everything queued has
+ * been written.
+ */
+void subproc_closein(subproc* sp);
+
+/**
+ * This function returns the number of bytes from subproc_write() that are
+ * waiting to be written to the sub-process's stdin.
+ */
+size_t subproc_queued(subproc* sp);
+
+/**
+ * This function makes the sub-process's stdout and stderr be captured in
+ * memory instead of being written to files, from the next time it is
+ * executed. Up to max bytes are kept per stream (0 means no limit); anything
+ * beyond that is discarded. Output is collected by the evloop the sub-process
+ * is watched with, and whatever is left when it is reaped is collected then.
+ */
+void subproc_capture(subproc* sp, size_t max);
+
+/**
+ * This function makes the sub-process keep only the most recent output of its
+ * stdout and stderr, instead of writing it to files, from the next time it is
+ * executed. Each stream gets a ring buffer of at least 4/3 of size bytes,
+ * rounded up to a power of two, so memory use stays fixed however long the
+ * sub-process runs. The extra third is room for a read in progress, which
+ * subproc_tail() never copies, so the last size bytes can always be had. It
+ * replaces subproc_capture() and is drained by the evloop the sub-process is
+ * watched with.
+ */
+void subproc_keeptail(subproc* sp, size_t size);
+
+/**
+ * This function copies up to size of the most recent bytes that the
+ * sub-process wrote to stdout (STDOUT_FILENO) or stderr (STDERR_FILENO) into
+ * buf, and returns the number of bytes copied. It can be called from any
+ * thread while the sub-process is running. Up to the size given to
+ * subproc_keeptail() is always available. Asking for more can return up to
+ * three quarters of the ring, as the quarter ahead of the oldest bytes is left
+ * out in case a read is writing to it.
+ */
+size_t subproc_tail(subproc* sp, int stream, char* buf, size_t size);
+
+/**
+ * This function connects the sub-process's stdin (STDIN_FILENO), stdout
+ * (STDOUT_FILENO) or stderr (STDERR_FILENO) to the file descriptor provided
+ * the next time it is executed only, in place of anything set up with
+ * subproc_stdin(), subproc_capture() or subproc_stream() for that stream.
+ * The subproc takes the file descriptor and closes it once the child has its
+ * copy, so it should be opened with O_CLOEXEC to keep it out of other
+ * children.
+ */
+void subproc_redirect(subproc* sp, int stream, int fd);
+
+/**
+ * This function adds a file descriptor that the sub-process's stdout
+ * (STDOUT_FILENO) or stderr (STDERR_FILENO) is passed on to, from the next
+ * time it is executed. A stream with sinks goes through a pipe owned by the
+ * parent instead of a file, and is moved to its sinks with splice() and tee()
+ * by the evloop the sub-process is watched with, without being copied into
+ * memory unless subproc_capture() is also used. Sinks may be files, sockets or
+ * pipes; they are written to in blocking mode and are not closed. A sink that
+ * fails, such as a socket whose reader has gone, is reported on stderr and
+ * dropped, and the stream carries on to the others. SIGPIPE is ignored unless
+ * the program handles it.
+ */
+void subproc_stream(subproc* sp, int stream, int fd);
+
+/**
+ * This function returns the output captured from the sub-process's stdout and
+ * stores its length at len if len is not NULL. The bytes are not copied and
+ * are followed by a null character; they remain valid until the sub-process
+ * is executed again or destroyed.
+ */
+const char* subproc_out(subproc* sp, size_t* len);
+
+/**
+ * This function returns the output captured from the sub-process's stderr in
+ * the same way as subproc_out().
+ */
+const char* subproc_err(subproc* sp, size_t* len);
+
 /**
  * This function executes the command provided to it as a sub-process.
+ * The output files and file descriptors are set up by the parent before the
+ * sub-process is launched with posix_spawn(), so the child only duplicates
+ * its descriptors and executes the command. Its stdin is /dev/null unless
+ * subproc_stdin() was used. Its stdout and stderr are written to files in fdir
+ * named after the command, such as ls_out.txt and ls_err.txt, and numbered by
+ * their launch if subproc_numberfiles() was used.
  */
 void subproc_exec( subproc* sp, char* cmd, char* fdir );
 
 /**
- * This function requests for the provided sub-process to be terminated, waits
- * for it to exit, and reports its exit-status to stdout or stderr if there
- * was an error.
+ * This function executes the program named by argv[0] as a sub-process,
+ * without going through a shell. If argv[0] contains no slash it is looked up
+ * in PATH, and the result is cached for later calls. If envp is NULL the
+ * sub-process inherits the environment of its parent. Output is written to
+ * files in fdir in the same way as subproc_exec().
+ */
+void subproc_execv(subproc* sp, char* const argv[], char* const envp[],
+                                                    char* fdir);
+
+/**
+ * This function executes the n commands described by specs as sub-processes,
+ * one in each of the n initialised subprocs in sps, with their output written
+ * to files in fdir in the same way as subproc_exec(). Every executable is
+ * resolved and the environment copied before any is started, and the output
+ * directory is opened once and the files created relative to it, so a batch
+ * costs little more than its posix_spawn() calls.
+ */
+void subproc_exec_many(subproc* sps, const subproc_spec* specs, size_t n,
+                                                                char* fdir);
+
+/**
+ * This function empties the termination policy provided to it. If group is
+ * true its signals are sent to the sub-process's whole process group when it
+ * leads one of its own, even if it was not started in one by
+ * subproc_setgroup(). A suspended sub-process is continued after each
+ * signal so that it can act on it.
+ */
+void subproc_termpolicy_init(subproc_termpolicy* policy, bool group);
+
+/**
+ * This function adds a step to the termination policy provided to it: the
+ * signal sig is sent, and the sub-process is given grace nanoseconds to exit
+ * before the next step. The grace of the last step is not used. Steps beyond
+ * SUBPROC_MAX_TERMSTEPS are ignored.
+ */
+void subproc_termpolicy_add(subproc_termpolicy* policy, int sig,
+                                                        uint64_t grace);
+
+/**
+ * This function sets the termination policy used to stop the sub-process.
+ * Passing NULL, or a policy with no steps, restores the default policy, which
+ * sends SIGTERM and then SIGKILL after 2 seconds.
+ */
+void subproc_setterm(subproc* sp, const subproc_termpolicy* policy);
+
+/**
+ * This function terminates the provided sub-process by following its
+ * termination policy, waits for it to exit, and reports its exit-status to
+ * stdout or stderr if there was an error.
  */
 void subproc_term( subproc* sp );
 
+/**
+ * This function starts terminating the provided sub-process by following its
+ * termination policy, without waiting. The steps are timed by the evloop it is
+ * watched with, and stop as soon as it has been reaped, so many sub-processes
+ * can be stopped at once in the time of one policy. A sub-process that is not
+ * watched is terminated with subproc_term().
+ */
+void subproc_term_async(subproc* sp);
+
+/**
+ * This function registers the sub-process with the evloop provided to it.
+ * When the sub-process exits it is reaped by the evloop and the function
+ * provided is called with arg. A pidfd is used to watch the sub-process
+ * where the kernel supports it, otherwise SIGCHLD is received through a
+ * signalfd registered with the first evloop this function is used with.
+ */
+void subproc_watch(subproc* sp, evloop* ev, subproc_exitfn fn, void* arg);
+
+/**
+ * This function registers the n subprocs in sps with the evloop provided, as
+ * subproc_watch() does for each of them.
+ */
+void subproc_watch_many(subproc* sps, size_t n, evloop* ev, subproc_exitfn fn,
+                                                              void* arg);
+
+/**
+ * This function returns the process id of the sub-process.
+ */
+pid_t subproc_pid(subproc* sp);
+
+/**
+ * This function returns true if the sub-process has been executed and has not
+ * been reaped yet.
+ */
+bool subproc_running(subproc* sp);
+
+/**
+ * This function returns the status that wait4() reported for the
+ * sub-process when it was reaped.
+ */
+int subproc_status(subproc* sp);
+
+/**
+ * This function makes the evloop the sub-process is watched with sample its
+ * /proc/<pid>/stat and /proc/<pid>/io every interval nanoseconds while it
+ * runs, from the next time it is watched. An interval of 0 stops sampling.
+ */
+void subproc_sample(subproc* sp, uint64_t interval);
+
+/**
+ * This function copies the metrics of the sub-process's last run to m. They
+ * are complete once the sub-process has been reaped.
+ */
+void subproc_getmetrics(subproc* sp, subproc_metrics* m);
+
+/**
+ * This function writes the names of the CSV columns written by
+ * subproc_metrics_writecsv() to the file stream provided to it.
+ */
+void subproc_metrics_csvheader(FILE* fs);
+
+/**
+ * This function writes the metrics provided to it to the file stream provided
+ * to it as a line of CSV.
+ */
+void subproc_metrics_writecsv(FILE* fs, const subproc_metrics* m);
+
+/**
+ * This function writes the metrics provided to it to the file stream provided
+ * to it as a fixed-size binary record, in the layout of subproc_metrics and in
+ * the byte order of the host.
+ */
+void subproc_metrics_writebin(FILE* fs, const subproc_metrics* m);
+
 #endif // SUBPROC_H
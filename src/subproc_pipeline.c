@@ -0,0 +1,390 @@
+/**
+ * subproc_pipeline.c
+ *
+ * This file contains the internal data and function definitions for the
+ * subproc_pipeline type.
+ *
+ * The subproc_pipeline type runs a chain of sub-processes, like a shell
+ * pipeline, with the stdout of each stage connected straight to the stdin of
+ * the next by a pipe, so the data never passes through the parent.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#define _GNU_SOURCE
+
+#include "subproc_pipeline.h"
+
+/**
+ * This is one stage of a pipeline. Each is allocated on its own so the
+ * subproc handed out for it stays where it is as more stages are added.
+ */
+struct stage {
+    subproc sp;         /* The sub-process running the stage. */
+    char** argv;        /* The program and its arguments, or NULL. */
+    char* cmd;          /* The shell command, or NULL. */
+    bool done;          /* Whether the stage has been reaped. */
+};
+
+/**
+ * This is the internal data contained within the subproc_pipeline type.
+ */
+struct subproc_pipeline_data {
+    struct stage** stages;  /* The stages, in order. */
+    size_t len;             /* The number of stages. */
+    size_t cap;             /* The number of slots in the list of stages. */
+    size_t pipesize;        /* The size asked for the pipes, or 0. */
+    size_t running;         /* The number of stages not yet reaped. */
+    evloop* ev;             /* The evloop reaping the stages, or NULL. */
+    subproc_pipelinefn fn;  /* Called when every stage has been reaped. */
+    void* arg;              /* The argument to pass to fn. */
+    uint64_t start_ns;      /* When the first stage was started. */
+    uint64_t end_ns;        /* When the last stage was reaped, or 0. */
+    subproc_pipeline self;  /* This pipeline, handed to fn. */
+};
+
+/**
+ * This function initialises the subproc_pipeline provided to it.
+ */
+void subproc_pipeline_init(subproc_pipeline* pl)
+{
+    /* Allocate memory to the pipeline. */
+    *pl = (subproc_pipeline) malloc(sizeof(struct subproc_pipeline_data));
+
+    /* Initialise the pipeline's data. */
+    (*pl)->stages = NULL;
+    (*pl)->len = 0;
+    (*pl)->cap = 0;
+    (*pl)->pipesize = 0;
+    (*pl)->running = 0;
+    (*pl)->ev = NULL;
+    (*pl)->fn = NULL;
+    (*pl)->arg = NULL;
+    (*pl)->start_ns = 0;
+    (*pl)->end_ns = 0;
+    (*pl)->self = *pl;
+}
+
+/**
+ * This function destroys the subproc_pipeline provided to it along with its
+ * stages.
+ */
+void subproc_pipeline_free(subproc_pipeline* pl)
+{
+    struct stage* st;   /* The current stage. */
+    char** arg;         /* The current argument. */
+    size_t i;           /* Index of the current stage. */
+
+    /* Terminate the running stages all at once, so they take no longer to
+     * stop than the slowest of them. */
+    if ((*pl)->ev != NULL)
+    {
+        for (i = 0; i < (*pl)->len; i++)
+            if (!(*pl)->stages[i]->done)
+                subproc_term_async(&(*pl)->stages[i]->sp);
+        while ((*pl)->running > 0)
+            evloop_run((*pl)->ev, -1);
+    }
+
+    /* Destroy the stages. */
+    for (i = 0; i < (*pl)->len; i++)
+    {
+        st = (*pl)->stages[i];
+        subproc_free(&st->sp);
+        if (st->argv != NULL)
+        {
+            for (arg = st->argv; *arg != NULL; arg++)
+                free(*arg);
+            free(st->argv);
+        }
+        free(st->cmd);
+        free(st);
+    }
+
+    /* De-allocate memory from the pipeline. */
+    free((*pl)->stages);
+    free(*pl);
+}
+
+/**
+ * This function adds a stage to the end of the pipeline and returns its
+ * subproc.
+ */
+subproc* addstage(subproc_pipeline* pl, char** argv, char* cmd)
+{
+    struct stage* st;   /* The stage. */
+
+    /* Create the stage. */
+    st = (struct stage*) malloc(sizeof(struct stage));
+    subproc_init(&st->sp);
+    st->argv = argv;
+    st->cmd = cmd;
+    st->done = true;
+
+    /* Add it to the end of the list. */
+    if ((*pl)->len == (*pl)->cap)
+    {
+        (*pl)->cap = ((*pl)->cap > 0) ? (*pl)->cap * 2 : 8;
+        (*pl)->stages = (struct stage**) realloc((*pl)->stages,
+                                    sizeof(struct stage*) * (*pl)->cap);
+    }
+    (*pl)->stages[(*pl)->len++] = st;
+
+    return &st->sp;
+}
+
+/**
+ * This function adds a stage that executes the program named by argv[0] to
+ * the end of the pipeline.
+ */
+subproc* subproc_pipeline_add(subproc_pipeline* pl, char* const argv[])
+{
+    char** argv_cpy;    /* A copy of the arguments. */
+    size_t argc;        /* The number of arguments. */
+    size_t i;           /* Index of the current argument. */
+
+    /* Copy the arguments, as the pipeline may be executed later. */
+    for (argc = 0; argv[argc] != NULL; argc++);
+    argv_cpy = (char**) malloc(sizeof(char*) * (argc + 1));
+    for (i = 0; i < argc; i++)
+        strfmt(&argv_cpy[i], "%s", argv[i]);
+    argv_cpy[argc] = NULL;
+
+    /* Add the stage. */
+    return addstage(pl, argv_cpy, NULL);
+}
+
+/**
+ * This function adds a stage that executes a shell command to the end of the
+ * pipeline.
+ */
+subproc* subproc_pipeline_addsh(subproc_pipeline* pl, char* cmd)
+{
+    char* cmd_cpy;  /* A copy of the command. */
+
+    /* Copy the command, as the pipeline may be executed later. */
+    strfmt(&cmd_cpy, "%s", cmd);
+
+    /* Add the stage. */
+    return addstage(pl, NULL, cmd_cpy);
+}
+
+/**
+ * This function sets the size asked for the pipes between the stages.
+ */
+void subproc_pipeline_pipesize(subproc_pipeline* pl, size_t size)
+{
+    (*pl)->pipesize = size;
+}
+
+/**
+ * This function creates the pipe that connects the stage at index i to the
+ * next one, and hands its ends to the two stages.
+ */
+void connect_stages(struct subproc_pipeline_data* pl, size_t i)
+{
+    int fds[2];     /* The pipe. */
+
+    /* Create the pipe. Both ends are closed on exec, so each child only has
+     * the duplicate it is given and a stage sees end of file as soon as the
+     * one before it exits. */
+    if (pipe2(fds, O_CLOEXEC) == -1)
+    {
+        /* There was an error creating the pipe so print it and exit the
+         * program. */
+        fprintf(stderr,
+                "[ %s ] ERROR: In connect_stages(): pipe() - %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* Grow the pipe if asked to. The kernel limits how large an unprivileged
+     * process may make a pipe, so a failure just leaves the default size. */
+    if (pl->pipesize > 0)
+        fcntl(fds[1], F_SETPIPE_SZ, (int) pl->pipesize);
+
+    /* The stage writes into the pipe and the next stage reads from it. */
+    subproc_redirect(&pl->stages[i]->sp, STDOUT_FILENO, fds[1]);
+    subproc_redirect(&pl->stages[i + 1]->sp, STDIN_FILENO, fds[0]);
+}
+
+/**
+ * This function executes every stage of the pipeline, connected by pipes.
+ */
+void subproc_pipeline_exec(subproc_pipeline* pl, char* fdir)
+{
+    subproc* sps;           /* The subprocs of the stages. */
+    subproc_spec* specs;    /* The commands of the stages. */
+    size_t i;               /* Index of the current stage. */
+
+    /* Nothing to do without any stages. */
+    if ((*pl)->len == 0)
+        return;
+
+    /* Create every pipe before any stage is started. */
+    for (i = 0; i + 1 < (*pl)->len; i++)
+        connect_stages(*pl, i);
+
+    /* Describe the stages as a batch. The subprocs are handles, so the
+     * copies refer to the same sub-processes as the stages. */
+    sps = (subproc*) malloc(sizeof(subproc) * (*pl)->len);
+    specs = (subproc_spec*) malloc(sizeof(subproc_spec) * (*pl)->len);
+    for (i = 0; i < (*pl)->len; i++)
+    {
+        sps[i] = (*pl)->stages[i]->sp;
+        specs[i].argv = (*pl)->stages[i]->argv;
+        specs[i].cmd = (*pl)->stages[i]->cmd;
+        specs[i].envp = NULL;
+        (*pl)->stages[i]->done = false;
+    }
+
+    /* Launch the stages. */
+    (*pl)->running = (*pl)->len;
+    (*pl)->end_ns = 0;
+    (*pl)->start_ns = mono_now();
+    subproc_exec_many(sps, specs, (*pl)->len, fdir);
+
+    /* Cleaning up. */
+    free(sps);
+    free(specs);
+}
+
+/**
+ * This function is called when a stage of the pipeline has been reaped.
+ */
+void on_stageexit(subproc* sp, int status, void* arg)
+{
+    struct subproc_pipeline_data* pl = arg;     /* The pipeline. */
+    size_t i;                                   /* Index of the stage. */
+
+    /* Record that the stage has been reaped. The subproc passed in is not
+     * necessarily the stage's own handle, but refers to the same data. */
+    for (i = 0; i < pl->len; i++)
+        if (pl->stages[i]->sp == *sp)
+            pl->stages[i]->done = true;
+
+    /* Tell the owner once they all have. */
+    if (--pl->running == 0)
+    {
+        pl->end_ns = mono_now();
+        if (pl->fn != NULL)
+            pl->fn(&pl->self, subproc_pipeline_status(&pl->self), pl->arg);
+    }
+}
+
+/**
+ * This function reaps the stages of the pipeline through the evloop provided
+ * as they exit.
+ */
+void subproc_pipeline_watch(subproc_pipeline* pl, evloop* ev,
+                            subproc_pipelinefn fn, void* arg)
+{
+    size_t i;   /* Index of the current stage. */
+
+    (*pl)->ev = ev;
+    (*pl)->fn = fn;
+    (*pl)->arg = arg;
+    for (i = 0; i < (*pl)->len; i++)
+        subproc_watch(&(*pl)->stages[i]->sp, ev, on_stageexit, *pl);
+}
+
+/**
+ * This function returns true if every stage of the pipeline has been reaped.
+ */
+bool subproc_pipeline_done(subproc_pipeline* pl)
+{
+    return (*pl)->running == 0;
+}
+
+/**
+ * This function runs the evloop the pipeline is watched through until every
+ * stage has been reaped, then returns the status of the last stage.
+ */
+int subproc_pipeline_wait(subproc_pipeline* pl)
+{
+    /* Handle events until every stage has been reaped. */
+    while ((*pl)->running > 0)
+        evloop_run((*pl)->ev, -1);
+
+    return subproc_pipeline_status(pl);
+}
+
+/**
+ * This function returns the number of stages in the pipeline.
+ */
+size_t subproc_pipeline_len(subproc_pipeline* pl)
+{
+    return (*pl)->len;
+}
+
+/**
+ * This function returns the subproc of the stage at index i.
+ */
+subproc* subproc_pipeline_stage(subproc_pipeline* pl, size_t i)
+{
+    return &(*pl)->stages[i]->sp;
+}
+
+/**
+ * This function returns true if the stage at index i has been reaped.
+ */
+bool subproc_pipeline_stagedone(subproc_pipeline* pl, size_t i)
+{
+    return (*pl)->stages[i]->done;
+}
+
+/**
+ * This function returns the status of the last stage of the pipeline.
+ */
+int subproc_pipeline_status(subproc_pipeline* pl)
+{
+    return ((*pl)->len > 0) ?
+           subproc_status(&(*pl)->stages[(*pl)->len - 1]->sp) : 0;
+}
+
+/**
+ * This function returns the status of the last stage that did not exit with
+ * 0, or 0 if every stage did.
+ */
+int subproc_pipeline_pipefail(subproc_pipeline* pl)
+{
+    int status;     /* The status of the current stage. */
+    size_t i;       /* Index of the current stage. */
+
+    for (i = (*pl)->len; i > 0; i--)
+        if ((status = subproc_status(&(*pl)->stages[i - 1]->sp)) != 0)
+            return status;
+
+    return 0;
+}
+
+/**
+ * This function returns the number of nanoseconds the pipeline has run for.
+ */
+uint64_t subproc_pipeline_wall(subproc_pipeline* pl)
+{
+    /* Nothing has run if the pipeline was never executed. */
+    if ((*pl)->start_ns == 0)
+        return 0;
+
+    return (((*pl)->end_ns != 0) ? (*pl)->end_ns : mono_now()) -
+           (*pl)->start_ns;
+}
+
+/**
+ * This function writes the metrics of every stage of the pipeline to the file
+ * stream provided as CSV.
+ */
+void subproc_pipeline_report(subproc_pipeline* pl, FILE* fs)
+{
+    subproc_metrics m;  /* The metrics of the current stage. */
+    size_t i;           /* Index of the current stage. */
+
+    subproc_metrics_csvheader(fs);
+    for (i = 0; i < (*pl)->len; i++)
+    {
+        subproc_getmetrics(&(*pl)->stages[i]->sp, &m);
+        subproc_metrics_writecsv(fs, &m);
+    }
+}
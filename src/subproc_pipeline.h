@@ -0,0 +1,148 @@
+/**
+ * subproc_pipeline.h
+ *
+ * This file contains the publicly available data-structure and function
+ * prototype declarations for the subproc_pipeline type.
+ *
+ * The subproc_pipeline type runs a chain of sub-processes, like a shell
+ * pipeline, with the stdout of each stage connected straight to the stdin of
+ * the next by a pipe, so the data never passes through the parent.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#ifndef SUBPROC_PIPELINE_H
+#define SUBPROC_PIPELINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mycutils.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This is the subproc_pipeline data-structure.
+ */
+typedef struct subproc_pipeline_data* subproc_pipeline;
+
+/**
+ * This is the type of function that is called when every stage of a pipeline
+ * has been reaped. The status is the one reported for the last stage, as a
+ * shell reports it.
+ */
+typedef void (*subproc_pipelinefn)(subproc_pipeline* pl, int status,
+                                                         void* arg);
+
+/**
+ * This function initialises the subproc_pipeline provided to it with no
+ * stages.
+ */
+void subproc_pipeline_init(subproc_pipeline* pl);
+
+/**
+ * This function destroys the subproc_pipeline provided to it along with its
+ * stages. If it is being watched, stages that are still running are
+ * terminated, all at once, by following their termination policies.
+ */
+void subproc_pipeline_free(subproc_pipeline* pl);
+
+/**
+ * This function adds a stage that executes the program named by argv[0] to
+ * the end of the pipeline, and returns its subproc. The subproc can be set up
+ * as any other before the pipeline is executed, such as with subproc_stdin()
+ * on the first stage or subproc_capture() on the last, but the stdin of every
+ * stage but the first and the stdout of every stage but the last belong to
+ * the pipeline.
+ */
+subproc* subproc_pipeline_add(subproc_pipeline* pl, char* const argv[]);
+
+/**
+ * This function adds a stage that executes a shell command to the end of the
+ * pipeline, as subproc_pipeline_add() does.
+ */
+subproc* subproc_pipeline_addsh(subproc_pipeline* pl, char* cmd);
+
+/**
+ * This function asks for the pipes between the stages to hold size bytes,
+ * rather than the kernel's default, the next time the pipeline is executed.
+ * Larger pipes mean the stages wake each other less often. A size the kernel
+ * will not allow leaves a pipe at its default size. 0 means the default.
+ */
+void subproc_pipeline_pipesize(subproc_pipeline* pl, size_t size);
+
+/**
+ * This function executes every stage of the pipeline, connected by pipes,
+ * through subproc_exec_many(). Every stage's stderr, the last stage's stdout
+ * and the first stage's stdin are dealt with as for any other subproc.
+ */
+void subproc_pipeline_exec(subproc_pipeline* pl, char* fdir);
+
+/**
+ * This function reaps the stages of the pipeline through the evloop provided
+ * as they exit. Once every stage has been reaped fn is called with arg, if
+ * fn is not NULL.
+ */
+void subproc_pipeline_watch(subproc_pipeline* pl, evloop* ev,
+                            subproc_pipelinefn fn, void* arg);
+
+/**
+ * This function returns true if every stage of the pipeline has been reaped.
+ */
+bool subproc_pipeline_done(subproc_pipeline* pl);
+
+/**
+ * This function runs the evloop the pipeline is watched through until every
+ * stage has been reaped, then returns the status of the last stage.
+ */
+int subproc_pipeline_wait(subproc_pipeline* pl);
+
+/**
+ * This function returns the number of stages in the pipeline.
+ */
+size_t subproc_pipeline_len(subproc_pipeline* pl);
+
+/**
+ * This function returns the subproc of the stage at index i, from which its
+ * status and metrics can be read.
+ */
+subproc* subproc_pipeline_stage(subproc_pipeline* pl, size_t i);
+
+/**
+ * This function returns true if the stage at index i has been reaped, or was
+ * never executed.
+ */
+bool subproc_pipeline_stagedone(subproc_pipeline* pl, size_t i);
+
+/**
+ * This function returns the status of the last stage of the pipeline.
+ */
+int subproc_pipeline_status(subproc_pipeline* pl);
+
+/**
+ * This function returns the status of the last stage that did not exit with
+ * 0, or 0 if every stage did, as a shell's pipefail option reports it.
+ */
+int subproc_pipeline_pipefail(subproc_pipeline* pl);
+
+/**
+ * This function returns the number of nanoseconds from the first stage being
+ * started until the last one was reaped, or until now if some are still
+ * running.
+ */
+uint64_t subproc_pipeline_wall(subproc_pipeline* pl);
+
+/**
+ * This function writes the metrics of every stage of the pipeline to the file
+ * stream provided as CSV, one line per stage after a header line.
+ */
+void subproc_pipeline_report(subproc_pipeline* pl, FILE* fs);
+
+#endif // SUBPROC_PIPELINE_H
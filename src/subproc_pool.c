@@ -0,0 +1,331 @@
+/**
+ * subproc_pool.c
+ *
+ * This file contains the internal data and function definitions for the
+ * subproc_pool type.
+ *
+ * The subproc_pool type runs a queue of jobs as sub-processes, keeping no more
+ * than a set number of them running at once.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#define _GNU_SOURCE
+
+#include "subproc_pool.h"
+
+/**
+ * This is the internal data contained within the subproc_job type.
+ */
+struct subproc_job_data {
+    char** argv;                /* The program and its arguments, or NULL. */
+    char* cmd;                  /* The shell command, or NULL. */
+    char* fdir;                 /* The directory for the output files. */
+    subproc sp;                 /* The sub-process running the job. */
+    subproc_jobfn fn;           /* Called when the job has finished. */
+    void* arg;                  /* The argument to pass to fn. */
+    bool started;               /* Whether the job has been started. */
+    bool done;                  /* Whether the job has finished. */
+    int status;                 /* The status the job exited with. */
+    subproc_job self;           /* This job, handed to callbacks. */
+    struct subproc_pool_data* pool;     /* The pool the job belongs to. */
+    struct subproc_job_data* next;      /* The next job in the queue. */
+};
+
+/**
+ * This is the internal data contained within the subproc_pool type.
+ */
+struct subproc_pool_data {
+    evloop ev;          /* The evloop reaping the jobs. */
+    evloop* evp;        /* The evloop being used. */
+    bool ownev;         /* Whether the evloop belongs to the pool. */
+    size_t limit;       /* The maximum number of jobs running at once. */
+    size_t running;     /* The number of jobs running. */
+    size_t pending;     /* The number of jobs in the queue. */
+    subproc_job head;   /* The first job in the queue. */
+    subproc_job tail;   /* The last job in the queue. */
+    subproc_job* jobs;  /* Every job that has been submitted. */
+    size_t len;         /* The number of jobs that have been submitted. */
+    size_t cap;         /* The number of slots in the list of jobs. */
+};
+
+/**
+ * This function returns the number of CPUs the program may run on.
+ */
+size_t ncpus()
+{
+    cpu_set_t set;  /* The CPUs the program may run on. */
+    long n;         /* The number of online CPUs. */
+
+    /* Count the CPUs in the program's affinity mask. */
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0)
+        return (size_t) CPU_COUNT(&set);
+
+    /* Fall back to the number of online CPUs. */
+    return ((n = sysconf(_SC_NPROCESSORS_ONLN)) > 0) ? (size_t) n : 1;
+}
+
+/**
+ * This function initialises the subproc_pool provided to it.
+ */
+void subproc_pool_init(subproc_pool* pool, evloop* ev, size_t limit)
+{
+    /* Allocate memory to the pool. */
+    *pool = (subproc_pool) malloc(sizeof(struct subproc_pool_data));
+
+    /* Use the evloop provided, or create one. */
+    if (((*pool)->ownev = (ev == NULL)))
+    {
+        evloop_init(&(*pool)->ev);
+        (*pool)->evp = &(*pool)->ev;
+    }
+    else
+        (*pool)->evp = ev;
+
+    /* Initialise the pool's data. */
+    (*pool)->limit = (limit > 0) ? limit : ncpus();
+    (*pool)->running = 0;
+    (*pool)->pending = 0;
+    (*pool)->head = NULL;
+    (*pool)->tail = NULL;
+    (*pool)->jobs = NULL;
+    (*pool)->len = 0;
+    (*pool)->cap = 0;
+}
+
+/**
+ * This function destroys the subproc_pool provided to it along with its jobs.
+ */
+void subproc_pool_free(subproc_pool* pool)
+{
+    subproc_job job;    /* The current job. */
+    char** arg;         /* The current argument. */
+    size_t i;           /* Index of the current job. */
+
+    /* Nothing more is started while the jobs are torn down. */
+    (*pool)->head = NULL;
+    (*pool)->pending = 0;
+
+    /* Terminate the running jobs all at once, so they take no longer to stop
+     * than the slowest of them. */
+    for (i = 0; i < (*pool)->len; i++)
+    {
+        job = (*pool)->jobs[i];
+        if (job->started && !job->done)
+            subproc_term_async(&job->sp);
+    }
+    while ((*pool)->running > 0)
+        evloop_run((*pool)->evp, -1);
+
+    /* Destroy the jobs. */
+    for (i = 0; i < (*pool)->len; i++)
+    {
+        job = (*pool)->jobs[i];
+        if (job->started)
+            subproc_free(&job->sp);
+        if (job->argv != NULL)
+        {
+            for (arg = job->argv; *arg != NULL; arg++)
+                free(*arg);
+            free(job->argv);
+        }
+        free(job->cmd);
+        free(job->fdir);
+        free(job);
+    }
+
+    /* De-allocate memory from the pool. */
+    if ((*pool)->ownev)
+        evloop_free(&(*pool)->ev);
+    free((*pool)->jobs);
+    free(*pool);
+}
+
+/**
+ * This function starts queued jobs until the pool is full.
+ */
+void fill(struct subproc_pool_data* pool);
+
+/**
+ * This function is called when the sub-process of a job has been reaped.
+ */
+void on_jobexit(subproc* sp, int status, void* arg)
+{
+    subproc_job job = (subproc_job) arg;    /* The job that finished. */
+
+    /* Record that the job has finished. */
+    job->done = true;
+    job->status = status;
+    job->pool->running--;
+
+    /* Tell the submitter, then use the free slot. */
+    if (job->fn != NULL)
+        job->fn(&job->self, status, job->arg);
+    fill(job->pool);
+}
+
+/**
+ * This function starts queued jobs until the pool is full.
+ */
+void fill(struct subproc_pool_data* pool)
+{
+    subproc_job job;    /* The job being started. */
+
+    while (pool->head != NULL && pool->running < pool->limit)
+    {
+        /* Take the job off the queue. */
+        job = pool->head;
+        if ((pool->head = job->next) == NULL)
+            pool->tail = NULL;
+        pool->pending--;
+        pool->running++;
+
+        /* Start the job and watch for it to finish. */
+        subproc_init(&job->sp);
+        if (job->argv != NULL)
+            subproc_execv(&job->sp, job->argv, NULL, job->fdir);
+        else
+            subproc_exec(&job->sp, job->cmd, job->fdir);
+        job->started = true;
+        subproc_watch(&job->sp, pool->evp, on_jobexit, job);
+    }
+}
+
+/**
+ * This function adds a job to the pool and starts it if there is room.
+ */
+subproc_job submit(subproc_pool* pool, char** argv, char* cmd, char* fdir,
+                                       subproc_jobfn fn, void* arg)
+{
+    subproc_job job;    /* The job. */
+
+    /* Create the job. */
+    job = (subproc_job) malloc(sizeof(struct subproc_job_data));
+    job->argv = argv;
+    job->cmd = cmd;
+    strfmt(&job->fdir, "%s", fdir);
+    job->fn = fn;
+    job->arg = arg;
+    job->started = false;
+    job->done = false;
+    job->status = 0;
+    job->self = job;
+    job->pool = *pool;
+    job->next = NULL;
+
+    /* Remember the job so it can be destroyed with the pool. */
+    if ((*pool)->len == (*pool)->cap)
+    {
+        (*pool)->cap = ((*pool)->cap > 0) ? (*pool)->cap * 2 : 64;
+        (*pool)->jobs = (subproc_job*) realloc((*pool)->jobs,
+                                        sizeof(subproc_job) * (*pool)->cap);
+    }
+    (*pool)->jobs[(*pool)->len++] = job;
+
+    /* Add the job to the end of the queue. */
+    if ((*pool)->tail != NULL)
+        (*pool)->tail->next = job;
+    else
+        (*pool)->head = job;
+    (*pool)->tail = job;
+    (*pool)->pending++;
+
+    /* Start it if there is a free slot. */
+    fill(*pool);
+
+    return job;
+}
+
+/**
+ * This function adds a job that executes the program named by argv[0] to the
+ * pool.
+ */
+subproc_job subproc_pool_submit(subproc_pool* pool, char* const argv[],
+                                char* fdir, subproc_jobfn fn, void* arg)
+{
+    char** argv_cpy;    /* A copy of the arguments. */
+    size_t argc;        /* The number of arguments. */
+    size_t i;           /* Index of the current argument. */
+
+    /* Copy the arguments, as the job may be started later. */
+    for (argc = 0; argv[argc] != NULL; argc++);
+    argv_cpy = (char**) malloc(sizeof(char*) * (argc + 1));
+    for (i = 0; i < argc; i++)
+        strfmt(&argv_cpy[i], "%s", argv[i]);
+    argv_cpy[argc] = NULL;
+
+    /* Submit the job. */
+    return submit(pool, argv_cpy, NULL, fdir, fn, arg);
+}
+
+/**
+ * This function adds a job that executes a shell command to the pool.
+ */
+subproc_job subproc_pool_submitsh(subproc_pool* pool, char* cmd, char* fdir,
+                                  subproc_jobfn fn, void* arg)
+{
+    char* cmd_cpy;  /* A copy of the command. */
+
+    /* Copy the command, as the job may be started later. */
+    strfmt(&cmd_cpy, "%s", cmd);
+
+    /* Submit the job. */
+    return submit(pool, NULL, cmd_cpy, fdir, fn, arg);
+}
+
+/**
+ * This function runs the pool's evloop until every job that has been
+ * submitted has finished.
+ */
+void subproc_pool_wait(subproc_pool* pool)
+{
+    /* Handle events until there is nothing left to run. */
+    while ((*pool)->running > 0 || (*pool)->pending > 0)
+        evloop_run((*pool)->evp, -1);
+}
+
+/**
+ * This function returns the number of jobs that are running.
+ */
+size_t subproc_pool_running(subproc_pool* pool)
+{
+    return (*pool)->running;
+}
+
+/**
+ * This function returns the number of jobs waiting for a free slot.
+ */
+size_t subproc_pool_pending(subproc_pool* pool)
+{
+    return (*pool)->pending;
+}
+
+/**
+ * This function returns true if the job has finished.
+ */
+bool subproc_job_done(subproc_job* job)
+{
+    return (*job)->done;
+}
+
+/**
+ * This function runs the pool's evloop until the job has finished, then
+ * returns the status that wait4() reported for it.
+ */
+int subproc_job_wait(subproc_job* job)
+{
+    /* Handle events until the job has finished. */
+    while (!(*job)->done)
+        evloop_run((*job)->pool->evp, -1);
+
+    return (*job)->status;
+}
+
+/**
+ * This function returns the sub-process of the job.
+ */
+subproc* subproc_job_subproc(subproc_job* job)
+{
+    return &(*job)->sp;
+}
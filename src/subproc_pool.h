@@ -0,0 +1,108 @@
+/**
+ * subproc_pool.h
+ *
+ * This file contains the publicly available data-structure and function
+ * prototype declarations for the subproc_pool type.
+ *
+ * The subproc_pool type runs a queue of jobs as sub-processes, keeping no more
+ * than a set number of them running at once.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#ifndef SUBPROC_POOL_H
+#define SUBPROC_POOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+
+#include "mycutils.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This is the subproc_pool data-structure.
+ */
+typedef struct subproc_pool_data* subproc_pool;
+
+/**
+ * This is a handle to a job that has been submitted to a subproc_pool. It
+ * belongs to the pool and stays valid until the pool is destroyed.
+ */
+typedef struct subproc_job_data* subproc_job;
+
+/**
+ * This is the type of function that is called when a job has finished. The
+ * status is the one reported by wait4().
+ */
+typedef void (*subproc_jobfn)(subproc_job* job, int status, void* arg);
+
+/**
+ * This function initialises the subproc_pool provided to it. No more than
+ * limit jobs will run at once; a limit of 0 means one job per CPU the program
+ * may run on. Jobs are reaped through the evloop provided, or through an
+ * evloop belonging to the pool if it is NULL.
+ */
+void subproc_pool_init(subproc_pool* pool, evloop* ev, size_t limit);
+
+/**
+ * This function destroys the subproc_pool provided to it along with its jobs.
+ * Jobs that are still running are terminated, all at once, by following their
+ * termination policies.
+ */
+void subproc_pool_free(subproc_pool* pool);
+
+/**
+ * This function adds a job that executes the program named by argv[0] to the
+ * pool, as subproc_execv() does. It is started as soon as there is a free
+ * slot. When it has finished, fn is called with arg if fn is not NULL.
+ */
+subproc_job subproc_pool_submit(subproc_pool* pool, char* const argv[],
+                                char* fdir, subproc_jobfn fn, void* arg);
+
+/**
+ * This function adds a job that executes a shell command to the pool, as
+ * subproc_exec() does.
+ */
+subproc_job subproc_pool_submitsh(subproc_pool* pool, char* cmd, char* fdir,
+                                  subproc_jobfn fn, void* arg);
+
+/**
+ * This function runs the pool's evloop until every job that has been
+ * submitted has finished.
+ */
+void subproc_pool_wait(subproc_pool* pool);
+
+/**
+ * This function returns the number of jobs that are running.
+ */
+size_t subproc_pool_running(subproc_pool* pool);
+
+/**
+ * This function returns the number of jobs waiting for a free slot.
+ */
+size_t subproc_pool_pending(subproc_pool* pool);
+
+/**
+ * This function returns true if the job has finished.
+ */
+bool subproc_job_done(subproc_job* job);
+
+/**
+ * This function runs the pool's evloop until the job has finished, then
+ * returns the status that wait4() reported for it.
+ */
+int subproc_job_wait(subproc_job* job);
+
+/**
+ * This function returns the sub-process of the job. It is only meaningful
+ * once the job has been started.
+ */
+subproc* subproc_job_subproc(subproc_job* job);
+
+#endif // SUBPROC_POOL_H
@@ -0,0 +1,76 @@
+/**
+ * check.c
+ *
+ * This file contains the function definitions shared by the tests.
+ *
+ * Each test makes its checks with CHECK(), which reports a failed check
+ * without stopping the test, and returns check_result() from main() so that
+ * ctest sees whether any of them failed.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "check.h"
+
+/* The number of checks that failed. */
+int failures = 0;
+
+/**
+ * This function creates a directory under /tmp for the files of the test
+ * named by name, and returns its path followed by a slash.
+ */
+char* check_mkdir(char* name)
+{
+    char* tmpl;     /* The template of the path. */
+    char* dir;      /* The path of the directory. */
+
+    /* Making a directory of our own. */
+    strfmt(&tmpl, "/tmp/%s_XXXXXX", name);
+    if (mkdtemp(tmpl) == NULL)
+    {
+        fprintf(stderr, "[ %s ] ERROR: In check_mkdir(): mkdtemp() - %s\n",
+                timestamp(), strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    /* The library expects the directory to end with a slash. */
+    strfmt(&dir, "%s/", tmpl);
+    free(tmpl);
+
+    return dir;
+}
+
+/**
+ * This function removes the directory created by check_mkdir() along with the
+ * files in it, and frees its path.
+ */
+void check_rmdir(char* dir)
+{
+    DIR* d;                 /* The directory. */
+    struct dirent* ent;     /* The current entry of the directory. */
+
+    /* Removing the files, then the directory. */
+    if ((d = opendir(dir)) != NULL)
+    {
+        while ((ent = readdir(d)) != NULL)
+            if (strcmp(ent->d_name, ".") != 0 && strcmp(ent->d_name, "..") != 0)
+                unlinkat(dirfd(d), ent->d_name, 0);
+        closedir(d);
+    }
+    rmdir(dir);
+    free(dir);
+}
+
+/**
+ * This function prints how many checks failed, if any, and returns the exit
+ * status of the test.
+ */
+int check_result()
+{
+    /* Reporting the failures. */
+    if (failures > 0)
+        fprintf(stderr, "%d check(s) failed\n", failures);
+
+    return (failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
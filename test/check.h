@@ -0,0 +1,62 @@
+/**
+ * check.h
+ *
+ * This file contains the macros and function prototype declarations shared
+ * by the tests.
+ *
+ * Each test makes its checks with CHECK(), which reports a failed check
+ * without stopping the test, and returns check_result() from main() so that
+ * ctest sees whether any of them failed.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+
+#include "mycutils.h"
+
+/**
+ * This is the number of checks that have failed.
+ */
+extern int failures;
+
+/**
+ * This macro records a failure, with where it happened, if cond is false.
+ */
+#define CHECK(cond)                                                         \
+    do                                                                      \
+    {                                                                       \
+        if (!(cond))                                                        \
+        {                                                                   \
+            fprintf(stderr, "%s:%d: check failed: %s\n",                    \
+                    __FILE__, __LINE__, #cond);                             \
+            failures++;                                                     \
+        }                                                                   \
+    } while (0)
+
+/**
+ * This function creates a directory under /tmp for the files of the test
+ * named by name, and returns its path followed by a slash.
+ */
+char* check_mkdir(char* name);
+
+/**
+ * This function removes the directory created by check_mkdir() along with the
+ * files in it, and frees its path.
+ */
+void check_rmdir(char* dir);
+
+/**
+ * This function prints how many checks failed, if any, and returns the exit
+ * status of the test.
+ */
+int check_result();
+
+#endif // CHECK_H
@@ -0,0 +1,77 @@
+/**
+ * test_evloop.c
+ *
+ * This file tests the timers of the evloop type: that a timer does not fire
+ * before its delay, that one that does not repeat fires once, that one that
+ * repeats keeps firing until it is removed from its own function, and that a
+ * timer removed before it expires never fires.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include "check.h"
+#include "evloop.h"
+
+/**
+ * This is what a timer of the test records each time it fires.
+ */
+struct fired {
+    int calls;          /* The number of times it fired. */
+    uint64_t first;     /* When it first fired. */
+    int stop;           /* The call to remove it on, or 0 to keep it. */
+};
+
+/**
+ * This function is called when a timer of the test expires, and records it.
+ */
+void on_fired(evloop* ev, evloop_timer* t, void* arg)
+{
+    struct fired* f = (struct fired*) arg;  /* What the timer recorded. */
+
+    /* Record the call, and remove the timer once it has fired enough. */
+    if (f->calls++ == 0)
+        f->first = mono_now();
+    if (f->stop != 0 && f->calls == f->stop)
+        evloop_deltimer(ev, t);
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    evloop ev;                      /* The evloop being tested. */
+    evloop_timer removed;           /* A timer removed before it expires. */
+    struct fired once = { 0 };      /* A timer that does not repeat. */
+    struct fired every = { 0 };     /* A timer that repeats. */
+    struct fired never = { 0 };     /* The timer that is removed. */
+    uint64_t start;                 /* When the timers were added. */
+    uint64_t deadline;              /* When the test gives up. */
+
+    /* A 20ms timer, a 5ms timer that repeats 4 times and a 10ms timer that
+     * is removed straight away. */
+    evloop_init(&ev);
+    every.stop = 4;
+    start = mono_now();
+    evloop_addtimer(&ev, 20000000, 0, on_fired, &once);
+    evloop_addtimer(&ev, 5000000, 5000000, on_fired, &every);
+    removed = evloop_addtimer(&ev, 10000000, 0, on_fired, &never);
+    evloop_deltimer(&ev, &removed);
+
+    /* Run the evloop for long enough for all of them to have fired. */
+    deadline = start + 100000000;
+    while (mono_now() < deadline)
+        evloop_run(&ev, 10);
+
+    /* Each fired as often as it should, and no sooner than its delay. */
+    CHECK(once.calls == 1);
+    CHECK(once.first - start >= 20000000);
+    CHECK(every.calls == 4);
+    CHECK(every.first - start >= 5000000);
+    CHECK(never.calls == 0);
+
+    evloop_free(&ev);
+
+    return check_result();
+}
@@ -0,0 +1,119 @@
+/**
+ * test_mycutils.c
+ *
+ * This file tests the arena and strbuf types and sdelchars(): that arena
+ * allocations are aligned and survive the block running out until the next
+ * reset, that a strbuf stays in its buffer until it outgrows it, and that
+ * sdelchars() removes every char of its set in place.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include <stdint.h>
+
+#include "check.h"
+
+/**
+ * This function tests the arena type and astrfmt().
+ */
+void test_arena()
+{
+    arena a;            /* The arena being tested. */
+    char* first;        /* A string from the block. */
+    char* spilled;      /* A string from an extra block. */
+    char long_str[200]; /* A string longer than the block. */
+    void* p;            /* An allocation. */
+    int i;              /* Index of the current allocation. */
+
+    /* Allocations are aligned for any type. */
+    arena_init(&a, 64);
+    for (i = 1; i < 8; i++)
+    {
+        p = arena_alloc(&a, i);
+        CHECK(p != NULL && (uintptr_t) p % _Alignof(max_align_t) == 0);
+    }
+
+    /* Strings outlive the block running out until the arena is reset. */
+    arena_reset(&a);
+    first = astrfmt(&a, "%s_%d", "ls", 3);
+    memset(long_str, 'x', sizeof(long_str) - 1);
+    long_str[sizeof(long_str) - 1] = '\0';
+    spilled = astrfmt(&a, "%s", long_str);
+    CHECK(strcmp(first, "ls_3") == 0);
+    CHECK(strcmp(spilled, long_str) == 0);
+
+    /* The block grows on reset so the same strings fit in it next time. */
+    arena_reset(&a);
+    CHECK(a.size >= 64 + sizeof(long_str));
+    CHECK(a.extra == NULL && a.used == 0);
+    spilled = astrfmt(&a, "%s", long_str);
+    CHECK(strcmp(spilled, long_str) == 0);
+    CHECK(a.extra == NULL);
+
+    arena_free(&a);
+}
+
+/**
+ * This function tests the strbuf type.
+ */
+void test_strbuf()
+{
+    strbuf sb;          /* The builder being tested. */
+    char buf[16];       /* The builder's stack buffer. */
+    int i;              /* Index of the current append. */
+
+    /* Short strings stay in the buffer provided. */
+    strbuf_init(&sb, buf, sizeof(buf));
+    strbuf_cat(&sb, "ls", 2);
+    strbuf_fmt(&sb, " -%c", 'l');
+    CHECK(sb.str == buf && !sb.heap);
+    CHECK(sb.len == 5 && strcmp(sb.str, "ls -l") == 0);
+
+    /* Longer ones move to the heap with their contents. */
+    for (i = 0; i < 10; i++)
+        strbuf_fmt(&sb, " %d", i);
+    CHECK(sb.heap && sb.str != buf);
+    CHECK(strcmp(sb.str, "ls -l 0 1 2 3 4 5 6 7 8 9") == 0);
+    CHECK(sb.len == strlen(sb.str));
+
+    /* Resetting empties it and keeps the memory. */
+    strbuf_reset(&sb);
+    CHECK(sb.len == 0 && sb.str[0] == '\0' && sb.heap);
+    strbuf_free(&sb);
+
+    /* A builder without a buffer allocates on first use. */
+    strbuf_init(&sb, NULL, 0);
+    strbuf_fmt(&sb, "%s", "echo");
+    CHECK(sb.heap && strcmp(sb.str, "echo") == 0);
+    strbuf_free(&sb);
+}
+
+/**
+ * This function tests sdelchars().
+ */
+void test_sdelchars()
+{
+    char cmd[] = "./bin/ls -la ../dir";     /* A command line. */
+    char none[] = "ls -la";                 /* One without the chars. */
+    char all[] = "/./";                     /* One with only the chars. */
+
+    /* Every char of the set is removed, and the new length returned. */
+    CHECK(sdelchars(cmd, "/.") == 13);
+    CHECK(strcmp(cmd, "binls -la dir") == 0);
+    CHECK(sdelchars(none, "/.") == 6 && strcmp(none, "ls -la") == 0);
+    CHECK(sdelchars(all, "/.") == 0 && all[0] == '\0');
+    CHECK(sdelchars(none, "") == 6 && strcmp(none, "ls -la") == 0);
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    test_arena();
+    test_strbuf();
+    test_sdelchars();
+
+    return check_result();
+}
@@ -0,0 +1,247 @@
+/**
+ * test_subproc.c
+ *
+ * This file tests the subproc type: that output is captured in memory up to
+ * its limit or kept in a ring buffer, that input queued for stdin and sent
+ * from a file reaches the sub-process, that a termination policy is followed
+ * both when waiting and when timed by an evloop, and that output files are
+ * only numbered when asked for.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "check.h"
+#include "evloop.h"
+#include "subproc.h"
+
+/**
+ * This function watches the sub-process provided to it with the evloop
+ * provided until it has been reaped, and returns its status.
+ */
+int reaped(subproc* sp, evloop* ev)
+{
+    /* Running the evloop until the sub-process is reaped. */
+    subproc_watch(sp, ev, NULL, NULL);
+    while (subproc_running(sp))
+        evloop_run(ev, -1);
+
+    return subproc_status(sp);
+}
+
+/**
+ * This function tests subproc_capture().
+ */
+void test_capture(evloop* ev, char* fdir)
+{
+    subproc sp;         /* The sub-process being tested. */
+    const char* out;    /* What it wrote to stdout. */
+    const char* err;    /* What it wrote to stderr. */
+    size_t len;         /* The length of out or err. */
+
+    /* Both streams are captured, separately. */
+    subproc_init(&sp);
+    subproc_capture(&sp, 0);
+    subproc_exec(&sp, "echo out; echo err >&2", fdir);
+    CHECK(WIFEXITED(reaped(&sp, ev)));
+    out = subproc_out(&sp, &len);
+    CHECK(out != NULL && len == 4 && strcmp(out, "out\n") == 0);
+    err = subproc_err(&sp, &len);
+    CHECK(err != NULL && len == 4 && strcmp(err, "err\n") == 0);
+
+    /* No more than the limit is kept, and the rest is read and dropped so
+     * the sub-process is not blocked. */
+    subproc_capture(&sp, 100);
+    subproc_exec(&sp, "head -c 100000 /dev/zero", fdir);
+    CHECK(WEXITSTATUS(reaped(&sp, ev)) == 0);
+    subproc_out(&sp, &len);
+    CHECK(len == 100);
+    subproc_free(&sp);
+}
+
+/**
+ * This function tests subproc_keeptail() and subproc_tail().
+ */
+void test_tail(evloop* ev, char* fdir)
+{
+    subproc sp;         /* The sub-process being tested. */
+    char buf[4096];     /* The tail. */
+    size_t len;         /* The length of the tail. */
+    char* end = "99999\n100000\n";      /* How the output ends. */
+
+    /* Only the end of a long stream is kept, and it is the true end. */
+    subproc_init(&sp);
+    subproc_keeptail(&sp, sizeof(buf));
+    subproc_exec(&sp, "seq 1 100000", fdir);
+    CHECK(WEXITSTATUS(reaped(&sp, ev)) == 0);
+    len = subproc_tail(&sp, STDOUT_FILENO, buf, sizeof(buf));
+    CHECK(len == sizeof(buf));
+    CHECK(memcmp(buf + len - strlen(end), end, strlen(end)) == 0);
+
+    /* Asking for less gives the most recent bytes. */
+    len = subproc_tail(&sp, STDOUT_FILENO, buf, 7);
+    CHECK(len == 7 && memcmp(buf, "100000\n", 7) == 0);
+    CHECK(subproc_tail(&sp, STDERR_FILENO, buf, sizeof(buf)) == 0);
+    subproc_free(&sp);
+}
+
+/**
+ * This function is called when the queue of the sub-process's stdin has
+ * emptied, and ends its input.
+ */
+void on_feed(subproc* sp, void* arg)
+{
+    /* Queue the rest of the input, once, and close it. */
+    if ((*(int*) arg)++ == 0)
+        subproc_write(sp, "world", 5);
+    subproc_closein(sp);
+}
+
+/**
+ * This function tests subproc_stdin() with subproc_write() and
+ * subproc_sendfile().
+ */
+void test_stdin(evloop* ev, char* fdir)
+{
+    subproc sp;         /* The sub-process being tested. */
+    const char* out;    /* What it wrote to stdout. */
+    size_t len;         /* The length of out. */
+    char* fname;        /* The file that is sent. */
+    int fd;             /* The file that is sent. */
+    int feeds = 0;      /* The number of times on_feed() was called. */
+
+    /* What is queued reaches the sub-process, and the feed function is
+     * called for more. */
+    subproc_init(&sp);
+    subproc_capture(&sp, 0);
+    subproc_stdin(&sp, 0, on_feed, &feeds);
+    subproc_execv(&sp, (char*[]) { "cat", NULL }, NULL, fdir);
+    CHECK(subproc_write(&sp, "hello ", 6) == 6);
+    CHECK(WEXITSTATUS(reaped(&sp, ev)) == 0);
+    CHECK(feeds >= 1);
+    CHECK(subproc_queued(&sp) == 0);
+    out = subproc_out(&sp, &len);
+    CHECK(out != NULL && len == 11 && strcmp(out, "hello world") == 0);
+
+    /* A file is sent without passing through memory. */
+    strfmt(&fname, "%s%s", fdir, "in.txt");
+    fd = openfd(fname, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    CHECK(write(fd, "from a file\n", 12) == 12);
+    lseek(fd, 0, SEEK_SET);
+    subproc_stdin(&sp, 0, NULL, NULL);
+    subproc_execv(&sp, (char*[]) { "cat", NULL }, NULL, fdir);
+    subproc_sendfile(&sp, fd, 0);
+    subproc_closein(&sp);
+    CHECK(WEXITSTATUS(reaped(&sp, ev)) == 0);
+    out = subproc_out(&sp, &len);
+    CHECK(out != NULL && len == 12 && strcmp(out, "from a file\n") == 0);
+    closefd(fd);
+    free(fname);
+    subproc_free(&sp);
+}
+
+/**
+ * This function tests termination policies with subproc_term() and
+ * subproc_term_async().
+ */
+void test_term(evloop* ev, char* fdir)
+{
+    subproc sp;                 /* The sub-process being tested. */
+    subproc_termpolicy policy;  /* SIGTERM, then SIGKILL after 100ms. */
+    uint64_t t;                 /* When termination started. */
+
+    /* A sub-process that ignores SIGTERM. */
+    char* cmd = "trap '' TERM; exec sleep 10";
+
+    /* Its policy gives it 100ms after SIGTERM before it is killed. */
+    subproc_termpolicy_init(&policy, false);
+    subproc_termpolicy_add(&policy, SIGTERM, 100000000);
+    subproc_termpolicy_add(&policy, SIGKILL, 0);
+
+    /* Waiting: the process is killed once the grace has passed. */
+    subproc_init(&sp);
+    subproc_setterm(&sp, &policy);
+    subproc_exec(&sp, cmd, fdir);
+    usleep(50000);
+    t = mono_now();
+    subproc_term(&sp);
+    t = mono_now() - t;
+    CHECK(!subproc_running(&sp));
+    CHECK(WIFSIGNALED(subproc_status(&sp)));
+    CHECK(WTERMSIG(subproc_status(&sp)) == SIGKILL);
+    CHECK(t >= 100000000 && t < 1000000000);
+
+    /* Timed by the evloop: calling it again while it is under way does not
+     * start the policy over. */
+    subproc_exec(&sp, cmd, fdir);
+    subproc_watch(&sp, ev, NULL, NULL);
+    usleep(50000);
+    t = mono_now();
+    subproc_term_async(&sp);
+    CHECK(subproc_running(&sp));
+    evloop_run(ev, 60);
+    subproc_term_async(&sp);
+    while (subproc_running(&sp))
+        evloop_run(ev, -1);
+    t = mono_now() - t;
+    CHECK(WIFSIGNALED(subproc_status(&sp)));
+    CHECK(WTERMSIG(subproc_status(&sp)) == SIGKILL);
+    CHECK(t >= 100000000 && t < 1000000000);
+    subproc_free(&sp);
+}
+
+/**
+ * This function tests how the output files are named.
+ */
+void test_files(evloop* ev, char* fdir)
+{
+    subproc sp;         /* The sub-process being tested. */
+    struct stat st;     /* The status of an output file. */
+    char* fname;        /* The name of an output file. */
+
+    /* The files are named after the command by default. */
+    subproc_init(&sp);
+    subproc_exec(&sp, "true", fdir);
+    reaped(&sp, ev);
+    strfmt(&fname, "%s%s", fdir, "true_out.txt");
+    CHECK(stat(fname, &st) == 0);
+    free(fname);
+
+    /* And numbered by their launch when asked to be. */
+    subproc_numberfiles(&sp, true);
+    subproc_exec(&sp, "true", fdir);
+    reaped(&sp, ev);
+    strfmt(&fname, "%s%s", fdir, "true_1_out.txt");
+    CHECK(stat(fname, &st) == 0);
+    free(fname);
+    subproc_free(&sp);
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    evloop ev;      /* Reaps the sub-processes. */
+    char* fdir;     /* The directory for the output files. */
+
+    /* Write the files of the sub-processes somewhere of their own. */
+    fdir = check_mkdir("test_subproc");
+    evloop_init(&ev);
+
+    test_capture(&ev, fdir);
+    test_tail(&ev, fdir);
+    test_stdin(&ev, fdir);
+    test_term(&ev, fdir);
+    test_files(&ev, fdir);
+
+    /* Cleaning up. */
+    evloop_free(&ev);
+    check_rmdir(fdir);
+
+    return check_result();
+}
@@ -0,0 +1,98 @@
+/**
+ * test_subproc_pipeline.c
+ *
+ * This file tests the subproc_pipeline type: that every stage is reaped and
+ * marked as done, that each stage reports its own exit status, and that data
+ * flows from one stage to the next.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include <sys/wait.h>
+
+#include "check.h"
+#include "evloop.h"
+#include "subproc.h"
+#include "subproc_pipeline.h"
+
+/**
+ * This function is called once every stage of the pipeline has been reaped,
+ * and counts how many times that happens.
+ */
+void on_done(subproc_pipeline* pl, int status, void* arg)
+{
+    /* Count the call. */
+    (*(int*) arg)++;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    subproc_pipeline pl;    /* The pipeline being tested. */
+    evloop ev;              /* Reaps the stages. */
+    subproc* last;          /* The last stage. */
+    char* fdir;             /* The directory for the output files. */
+    const char* out;        /* What the last stage wrote. */
+    size_t len;             /* The length of out. */
+    int calls = 0;          /* The number of times on_done() was called. */
+    int status;             /* The status of the pipeline. */
+    size_t i;               /* Index of the current stage. */
+
+    /* The stages: one that succeeds, one that fails after passing its input
+     * on, and one that reads everything and exits with its own status. */
+    char* first[] = { "printf", "a\\nb\\nc\\n", NULL };
+    char* last_cmd[] = { "wc", "-l", NULL };
+
+    /* Write the files of the stages somewhere of their own. */
+    fdir = check_mkdir("test_subproc_pipeline");
+
+    /* Build and run printf | sh -c "cat; exit 3" | wc -l. */
+    evloop_init(&ev);
+    subproc_pipeline_init(&pl);
+    subproc_pipeline_add(&pl, first);
+    subproc_pipeline_addsh(&pl, "cat; exit 3");
+    last = subproc_pipeline_add(&pl, last_cmd);
+    subproc_capture(last, 0);
+    subproc_pipeline_pipesize(&pl, 1 << 20);
+    CHECK(subproc_pipeline_len(&pl) == 3);
+
+    subproc_pipeline_exec(&pl, fdir);
+    subproc_pipeline_watch(&pl, &ev, on_done, &calls);
+    status = subproc_pipeline_wait(&pl);
+
+    /* Every stage has been reaped and marked as done. */
+    CHECK(subproc_pipeline_done(&pl));
+    CHECK(calls == 1);
+    for (i = 0; i < subproc_pipeline_len(&pl); i++)
+    {
+        CHECK(subproc_pipeline_stagedone(&pl, i));
+        CHECK(!subproc_running(subproc_pipeline_stage(&pl, i)));
+    }
+
+    /* Each stage reports its own exit status. */
+    CHECK(WIFEXITED(subproc_status(subproc_pipeline_stage(&pl, 0))));
+    CHECK(WEXITSTATUS(subproc_status(subproc_pipeline_stage(&pl, 0))) == 0);
+    CHECK(WIFEXITED(subproc_status(subproc_pipeline_stage(&pl, 1))));
+    CHECK(WEXITSTATUS(subproc_status(subproc_pipeline_stage(&pl, 1))) == 3);
+    CHECK(WIFEXITED(subproc_status(subproc_pipeline_stage(&pl, 2))));
+    CHECK(WEXITSTATUS(subproc_status(subproc_pipeline_stage(&pl, 2))) == 0);
+
+    /* The pipeline reports the last stage, or the last failure. */
+    CHECK(status == subproc_status(last));
+    CHECK(WEXITSTATUS(subproc_pipeline_pipefail(&pl)) == 3);
+    CHECK(subproc_pipeline_wall(&pl) > 0);
+
+    /* The data went through every stage. */
+    out = subproc_out(last, &len);
+    CHECK(out != NULL && atoi(out) == 3);
+
+    /* Cleaning up. */
+    subproc_pipeline_free(&pl);
+    evloop_free(&ev);
+    check_rmdir(fdir);
+
+    return check_result();
+}
@@ -0,0 +1,110 @@
+/**
+ * test_subproc_pool.c
+ *
+ * This file tests the subproc_pool type: that no more jobs run at once than
+ * its limit, that every job is started and reports its own exit status, and
+ * that destroying the pool stops the jobs that are still running.
+ *
+ * Author: Richard Gale
+ * Version: 1.0.1
+ */
+
+#include <sys/wait.h>
+
+#include "check.h"
+#include "evloop.h"
+#include "subproc.h"
+#include "subproc_pool.h"
+
+/**
+ * This is the number of shell jobs submitted.
+ */
+#define TEST_JOBS 5
+
+/**
+ * This is the most jobs the pool runs at once.
+ */
+#define TEST_LIMIT 2
+
+/**
+ * This is what the jobs of the test record as they finish.
+ */
+struct finished {
+    subproc_pool* pool;     /* The pool the jobs belong to. */
+    int calls;              /* The number of jobs that finished. */
+    size_t most;            /* The most jobs seen running at once. */
+};
+
+/**
+ * This function is called when a job has finished, and records it.
+ */
+void on_job(subproc_job* job, int status, void* arg)
+{
+    struct finished* f = (struct finished*) arg;    /* The record. */
+
+    /* Count the job, and how many were running alongside it. */
+    f->calls++;
+    if (subproc_pool_running(f->pool) + 1 > f->most)
+        f->most = subproc_pool_running(f->pool) + 1;
+}
+
+/**
+ * This is the program's main function.
+ */
+int main(int argc, char* argv[])
+{
+    subproc_pool pool;              /* The pool being tested. */
+    subproc_job jobs[TEST_JOBS];    /* The shell jobs. */
+    subproc_job job;                /* A job that runs a program. */
+    struct finished f = { &pool, 0, 0 };   /* What the jobs recorded. */
+    char* fdir;                     /* The directory for the output files. */
+    char cmd[64];                   /* The command of a shell job. */
+    uint64_t t;                     /* When the pool was destroyed. */
+    int i;                          /* Index of the current job. */
+
+    /* The jobs of the pool write their files somewhere of their own. */
+    fdir = check_mkdir("test_subproc_pool");
+
+    /* Jobs beyond the limit wait for a free slot. */
+    subproc_pool_init(&pool, NULL, TEST_LIMIT);
+    for (i = 0; i < TEST_JOBS; i++)
+    {
+        snprintf(cmd, sizeof(cmd), "sleep 0.05; exit %d", i);
+        jobs[i] = subproc_pool_submitsh(&pool, cmd, fdir, on_job, &f);
+    }
+    CHECK(subproc_pool_running(&pool) == TEST_LIMIT);
+    CHECK(subproc_pool_pending(&pool) == TEST_JOBS - TEST_LIMIT);
+
+    /* Every job runs, no more than the limit at once, and reports its own
+     * status. */
+    subproc_pool_wait(&pool);
+    CHECK(f.calls == TEST_JOBS);
+    CHECK(f.most <= TEST_LIMIT);
+    CHECK(subproc_pool_running(&pool) == 0);
+    CHECK(subproc_pool_pending(&pool) == 0);
+    for (i = 0; i < TEST_JOBS; i++)
+    {
+        CHECK(subproc_job_done(&jobs[i]));
+        CHECK(WIFEXITED(subproc_job_wait(&jobs[i])));
+        CHECK(WEXITSTATUS(subproc_job_wait(&jobs[i])) == i);
+        CHECK(!subproc_running(subproc_job_subproc(&jobs[i])));
+    }
+
+    /* A program is executed without a shell, and can be waited for on its
+     * own. */
+    job = subproc_pool_submit(&pool, (char*[]) { "false", NULL }, fdir,
+                              NULL, NULL);
+    CHECK(WEXITSTATUS(subproc_job_wait(&job)) == 1);
+    CHECK(subproc_job_done(&job));
+
+    /* Destroying the pool stops a job that would run for a long time. */
+    subproc_pool_submitsh(&pool, "exec sleep 10", fdir, NULL, NULL);
+    CHECK(subproc_pool_running(&pool) == 1);
+    t = mono_now();
+    subproc_pool_free(&pool);
+    CHECK(mono_now() - t < 1000000000);
+
+    check_rmdir(fdir);
+
+    return check_result();
+}